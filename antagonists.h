@@ -0,0 +1,203 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rt_thread.h"
+
+/*
+ * Noisy neighbours for interference benchmarks. Each antagonist loops until
+ * `stop` is set, optionally pinned to a CPU, and stresses one shared resource
+ * the RT thread depends on.
+ */
+
+enum class Antagonist {
+    MemoryBandwidth, // streams through a buffer far larger than the caches
+    CacheThrash,     // random lines across a buffer the size of the shared L3
+    SyscallStorm,    // back-to-back cheap system calls
+    PageFaults,      // maps, touches and unmaps fresh anonymous memory
+};
+
+/**
+ * @brief Name of an antagonist, as accepted by antagonist_from_name()
+ */
+inline const char *antagonist_name(Antagonist kind) {
+    switch (kind) {
+    case Antagonist::MemoryBandwidth:
+        return "membw";
+    case Antagonist::CacheThrash:
+        return "cache";
+    case Antagonist::SyscallStorm:
+        return "syscall";
+    case Antagonist::PageFaults:
+        return "pagefault";
+    }
+    return "?";
+}
+
+/**
+ * @brief Parses an antagonist name
+ * @return false if the name is unknown
+ */
+inline bool antagonist_from_name(const char *name, Antagonist &kind) {
+    for (Antagonist k : {Antagonist::MemoryBandwidth, Antagonist::CacheThrash, Antagonist::SyscallStorm,
+                         Antagonist::PageFaults}) {
+        if (strcmp(name, antagonist_name(k)) == 0) {
+            kind = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Size of the last-level cache of CPU 0, or 32 MiB if sysfs does not say
+ */
+inline size_t last_level_cache_bytes() {
+    size_t best = 0;
+    for (int index = 0; index < 8; ++index) {
+        char path[128];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+        FILE *file = fopen(path, "r");
+        if (file == nullptr)
+            break;
+        unsigned long value = 0;
+        char unit = 0;
+        if (fscanf(file, "%lu%c", &value, &unit) >= 1) {
+            size_t bytes = value * (unit == 'K' ? 1024 : unit == 'M' ? 1024 * 1024 : 1);
+            best = bytes > best ? bytes : best;
+        }
+        fclose(file);
+    }
+    return best > 0 ? best : size_t(32) << 20;
+}
+
+/**
+ * @brief Runs one antagonist until `stop` is set
+ * @param kind What to stress
+ * @param cpu CPU to pin to, or -1
+ * @param stop Set to end the loop
+ */
+inline void antagonist_run(Antagonist kind, int cpu, const std::atomic<bool> &stop) {
+    RtThreadConfig config;
+    config.cpu = cpu;
+    rt_thread_configure(config);
+
+    switch (kind) {
+    case Antagonist::MemoryBandwidth: {
+        std::vector<uint64_t> src(size_t(8) << 20), dst(src.size()); // 2 x 64 MiB
+        while (!stop.load(std::memory_order_relaxed)) {
+            memcpy(dst.data(), src.data(), src.size() * sizeof(uint64_t));
+            src[0] += dst[src.size() / 2];
+        }
+        break;
+    }
+    case Antagonist::CacheThrash: {
+        const size_t lines = last_level_cache_bytes() / 64;
+        std::vector<uint64_t> buffer(lines * 8);
+        uint64_t x = 88172645463325252ULL;
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (int i = 0; i < 4096; ++i) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                buffer[(x % lines) * 8] += 1;
+            }
+        }
+        break;
+    }
+    case Antagonist::SyscallStorm: {
+        int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        char byte = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            for (int i = 0; i < 256; ++i) {
+                syscall(SYS_getppid);
+                if (fd >= 0 && write(fd, &byte, 1) < 0)
+                    break;
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+        break;
+    }
+    case Antagonist::PageFaults: {
+        const size_t size = size_t(64) << 20;
+        const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        while (!stop.load(std::memory_order_relaxed)) {
+            void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map == MAP_FAILED)
+                break;
+            uint8_t *bytes = static_cast<uint8_t *>(map);
+            for (size_t off = 0; off < size && !stop.load(std::memory_order_relaxed); off += page)
+                bytes[off] = 1;
+            munmap(map, size);
+        }
+        break;
+    }
+    }
+}
+
+/**
+ * @brief A set of running antagonist threads.
+ */
+struct AntagonistGroup {
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+};
+
+/**
+ * @brief Every CPU this process may run on except `rt_cpu`, for keeping antagonists off the RT core
+ *
+ * Empty if there is no other CPU (or the affinity cannot be read).
+ */
+inline std::vector<int> antagonist_default_cpus(int rt_cpu) {
+    std::vector<int> cpus;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (cpu != rt_cpu && CPU_ISSET(cpu, &allowed))
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+/**
+ * @brief Starts `count` threads of each given kind, spread round-robin over `cpus`
+ *
+ * With an empty `cpus` list the threads are left to the scheduler.
+ */
+inline void antagonists_start(AntagonistGroup &group, const std::vector<Antagonist> &kinds, int count,
+                              const std::vector<int> &cpus) {
+    group.stop.store(false, std::memory_order_relaxed);
+    size_t next = 0;
+    for (Antagonist kind : kinds) {
+        for (int i = 0; i < count; ++i) {
+            const int cpu = cpus.empty() ? -1 : cpus[next++ % cpus.size()];
+            group.threads.emplace_back(antagonist_run, kind, cpu, std::cref(group.stop));
+        }
+    }
+}
+
+/**
+ * @brief Stops and joins all antagonists of a group
+ */
+inline void antagonists_stop(AntagonistGroup &group) {
+    group.stop.store(true, std::memory_order_relaxed);
+    for (auto &thread : group.threads)
+        thread.join();
+    group.threads.clear();
+}
@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "antagonists.h"
+#include "bench_results.h"
+#include "latency_histogram.h"
+#include "rt_thread.h"
+#include "spsc.h"
+#include "telemetry.h"
+
+/*
+ * spsc_bench: benchmarks for choosing the RT configuration of a host.
+ *
+ *   latency   cyclictest-style wake-up latency of the periodic timer, for
+ *             each timer mode, on a thread started by the RT thread launcher
+ *   interference
+ *             RT cycle jitter and RT-to-observer ring latency of the duplex,
+ *             alone and with noisy neighbours running on other cores
+ *
+ * With --json PATH every distribution is also saved, with host metadata, for
+ * spsc_compare to test against another run.
+ */
+
+struct BenchOptions {
+    std::vector<TimerMode> modes;
+    int64_t period_ns = 1000000;
+    double seconds = 5.0;
+    int64_t spin_ns = 50000;
+    RtThreadConfig rt;
+    int load_threads = 0;
+    bool print_buckets = false;
+    std::vector<Antagonist> antagonists;
+    int antagonist_threads = 1;
+    std::vector<int> antagonist_cpus;
+    int64_t observer_period_ns = 1000000;
+    const char *json_path = nullptr;
+};
+
+using Histogram = LatencyHistogram<>;
+
+/**
+ * @brief Background load: touches a private buffer and burns CPU until told to stop
+ */
+static void load_thread(std::atomic<bool> &stop) {
+    std::vector<uint64_t> buffer(1 << 20);
+    uint64_t x = 1;
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < buffer.size(); i += 8) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            buffer[i] += x;
+        }
+    }
+}
+
+/**
+ * @brief Measures wake-up latency of one timer mode for `seconds`
+ */
+static void measure_wakeups(const BenchOptions &options, TimerMode mode, Histogram &histogram) {
+    PeriodicTimer timer;
+    timer_start(timer, options.period_ns, mode, options.spin_ns);
+    const int64_t cycles = static_cast<int64_t>(options.seconds * 1e9) / options.period_ns;
+    for (int64_t i = 0; i < cycles; ++i)
+        histogram_add(histogram, timer_wait(timer));
+}
+
+static int run_latency(const BenchOptions &options, BenchResults &results) {
+    std::atomic<bool> stop_load{false};
+    std::vector<std::thread> load;
+    for (int i = 0; i < options.load_threads; ++i)
+        load.emplace_back(load_thread, std::ref(stop_load));
+
+    printf("period %.0f us, %.1f s per mode, cpu %d, priority %d, %d load threads\n", options.period_ns / 1000.0,
+           options.seconds, options.rt.cpu, options.rt.priority, options.load_threads);
+    for (TimerMode mode : options.modes) {
+        static Histogram histogram;
+        histogram = Histogram();
+        std::thread t = rt_thread_launch(options.rt, measure_wakeups, std::cref(options), mode, std::ref(histogram));
+        t.join();
+        histogram_print_summary(histogram, timer_mode_name(mode));
+        results.series.push_back(bench_series(std::string("latency/") + timer_mode_name(mode), histogram));
+        if (options.print_buckets)
+            histogram_print_buckets(histogram);
+    }
+
+    stop_load.store(true, std::memory_order_relaxed);
+    for (auto &thread : load)
+        thread.join();
+    return 0;
+}
+
+using DuplexRing = BasicRing<Sample<Message>, uint32_t, 1024>;
+
+/**
+ * @brief What one interference scenario measured.
+ */
+struct DuplexResult {
+    std::string scenario;
+    Histogram jitter;       // RT timer wake-up latency
+    Histogram ring_latency; // RT push to observer pop
+    uint64_t dropped = 0;   // samples the RT thread could not push
+};
+
+/**
+ * @brief RT side of the duplex: one timestamped sample per period into `ring`
+ */
+static void duplex_rt(const BenchOptions &options, DuplexRing &ring, DuplexResult &result, std::atomic<bool> &done) {
+    PeriodicTimer timer;
+    timer_start(timer, options.period_ns, TimerMode::ClockNanosleep);
+    const int64_t cycles = static_cast<int64_t>(options.seconds * 1e9) / options.period_ns;
+    Sample<Message> sample = {};
+    for (int64_t i = 0; i < cycles; ++i) {
+        histogram_add(result.jitter, timer_wait(timer));
+        sample.cycle = static_cast<uint64_t>(i);
+        sample.msg.arrayOfNumbers[0] = static_cast<float>(i);
+        sample.time_ns = monotonic_now_ns();
+        if (!try_push(ring, sample))
+            result.dropped += 1;
+    }
+    done.store(true, std::memory_order_release);
+}
+
+/**
+ * @brief Runs the RT/observer duplex for `seconds` with the given antagonists
+ */
+static void measure_duplex(const BenchOptions &options, const std::vector<Antagonist> &kinds, DuplexResult &result) {
+    static DuplexRing ring; // the observer empties it before each scenario ends
+    AntagonistGroup group;
+    antagonists_start(group, kinds, options.antagonist_threads, options.antagonist_cpus);
+
+    std::atomic<bool> done{false};
+    std::thread rt = rt_thread_launch(options.rt, duplex_rt, std::cref(options), std::ref(ring), std::ref(result),
+                                      std::ref(done));
+    Sample<Message> sample;
+    int64_t next_ns = monotonic_now_ns();
+    for (;;) {
+        const bool finished = done.load(std::memory_order_acquire);
+        while (try_pop(ring, sample))
+            histogram_add(result.ring_latency, monotonic_now_ns() - sample.time_ns);
+        if (finished)
+            break;
+        next_ns += options.observer_period_ns;
+        sleep_until_monotonic_ns(next_ns);
+    }
+    rt.join();
+    antagonists_stop(group);
+}
+
+static void print_duplex_row(const DuplexResult &result, const DuplexResult &baseline) {
+    const double jitter_p99 = histogram_percentile_us(result.jitter, 0.99);
+    const double ring_p99 = histogram_percentile_us(result.ring_latency, 0.99);
+    const double base_jitter_p99 = histogram_percentile_us(baseline.jitter, 0.99);
+    const double base_ring_p99 = histogram_percentile_us(baseline.ring_latency, 0.99);
+    printf("%-28s %7.0f %7.0f %9.1f   %7.0f %7.0f %9.1f   x%-6.2f x%-6.2f %llu\n", result.scenario.c_str(),
+           histogram_percentile_us(result.jitter, 0.50), jitter_p99, result.jitter.max_ns / 1000.0,
+           histogram_percentile_us(result.ring_latency, 0.50), ring_p99, result.ring_latency.max_ns / 1000.0,
+           base_jitter_p99 > 0 ? jitter_p99 / base_jitter_p99 : 0.0, base_ring_p99 > 0 ? ring_p99 / base_ring_p99 : 0.0,
+           static_cast<unsigned long long>(result.dropped));
+}
+
+static int run_interference(const BenchOptions &options, BenchResults &results) {
+    std::vector<std::pair<std::string, std::vector<Antagonist>>> scenarios;
+    scenarios.push_back({"none", {}});
+    for (Antagonist kind : options.antagonists)
+        scenarios.push_back({antagonist_name(kind), {kind}});
+    if (options.antagonists.size() > 1)
+        scenarios.push_back({"all", options.antagonists});
+
+    printf("period %.0f us, observer every %.0f us, %.1f s per scenario, rt cpu %d, priority %d, "
+           "%d thread(s) per antagonist\n",
+           options.period_ns / 1000.0, options.observer_period_ns / 1000.0, options.seconds, options.rt.cpu,
+           options.rt.priority, options.antagonist_threads);
+    std::vector<DuplexResult> scenario_results(scenarios.size());
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        scenario_results[i].scenario = scenarios[i].first;
+        measure_duplex(options, scenarios[i].second, scenario_results[i]);
+    }
+
+    printf("%-28s %25s   %25s   %15s\n", "", "rt jitter (us)", "ring latency (us)", "p99 vs none");
+    printf("%-28s %7s %7s %9s   %7s %7s %9s   %-7s %-7s %s\n", "scenario", "p50", "p99", "max", "p50", "p99", "max",
+           "jitter", "ring", "dropped");
+    for (const DuplexResult &result : scenario_results) {
+        print_duplex_row(result, scenario_results[0]);
+        results.series.push_back(bench_series("interference/" + result.scenario + "/jitter", result.jitter));
+        results.series.push_back(bench_series("interference/" + result.scenario + "/ring", result.ring_latency));
+    }
+    return 0;
+}
+
+/**
+ * @brief Parses a comma-separated list of antagonist names, or "all"
+ */
+static bool parse_antagonists(const char *list, std::vector<Antagonist> &kinds) {
+    kinds.clear();
+    if (strcmp(list, "all") == 0)
+        return true;
+    std::string names(list);
+    size_t start = 0;
+    while (start <= names.size()) {
+        size_t end = names.find(',', start);
+        if (end == std::string::npos)
+            end = names.size();
+        Antagonist kind;
+        if (!antagonist_from_name(names.substr(start, end - start).c_str(), kind))
+            return false;
+        kinds.push_back(kind);
+        start = end + 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Parses a comma-separated list of CPU numbers
+ */
+static bool parse_cpus(const char *list, std::vector<int> &cpus) {
+    cpus.clear();
+    const char *p = list;
+    while (*p != '\0') {
+        char *end = nullptr;
+        long cpu = strtol(p, &end, 10);
+        if (end == p || cpu < 0)
+            return false;
+        if (*end != ',' && *end != '\0')
+            return false;
+        cpus.push_back(static_cast<int>(cpu));
+        p = *end == ',' ? end + 1 : end;
+    }
+    return !cpus.empty();
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: spsc_bench latency [--mode sleep_until|nanosleep|hybrid|all] [--period-us N] [--seconds S]\n"
+            "                          [--spin-us N] [--cpu N] [--priority P] [--lock] [--load N] [--histogram]\n"
+            "                          [--json PATH]\n"
+            "       spsc_bench interference [--antagonists membw,cache,syscall,pagefault|all] [--threads N]\n"
+            "                          [--antagonist-cpus LIST] [--period-us N] [--observer-us N] [--seconds S]\n"
+            "                          [--cpu N] [--priority P] [--lock] [--json PATH]\n"
+            "  With --cpu, antagonists run on every other CPU unless --antagonist-cpus is given,\n"
+            "  which must not include the RT CPU.\n");
+}
+
+/**
+ * @brief Entry point of the benchmark tool
+ */
+int main(int argc, char **argv) {
+    const bool latency = argc >= 2 && strcmp(argv[1], "latency") == 0;
+    const bool interference = argc >= 2 && strcmp(argv[1], "interference") == 0;
+    if (!latency && !interference) {
+        usage();
+        return 2;
+    }
+
+    BenchOptions options;
+    if (interference)
+        options.seconds = 3.0;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            TimerMode mode;
+            if (strcmp(argv[++i], "all") == 0) {
+                options.modes.clear();
+            } else if (timer_mode_from_name(argv[i], mode)) {
+                options.modes.push_back(mode);
+            } else {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--period-us") == 0 && i + 1 < argc) {
+            options.period_ns = atoll(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--spin-us") == 0 && i + 1 < argc) {
+            options.spin_ns = atoll(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            options.rt.cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+            options.rt.priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--lock") == 0) {
+            options.rt.lock_memory = true;
+        } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+            options.load_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--histogram") == 0) {
+            options.print_buckets = true;
+        } else if (strcmp(argv[i], "--antagonists") == 0 && i + 1 < argc) {
+            if (!parse_antagonists(argv[++i], options.antagonists)) {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.antagonist_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--antagonist-cpus") == 0 && i + 1 < argc) {
+            if (!parse_cpus(argv[++i], options.antagonist_cpus)) {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--observer-us") == 0 && i + 1 < argc) {
+            options.observer_period_ns = atoll(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            options.json_path = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (options.period_ns <= 0 || options.observer_period_ns <= 0 || options.antagonist_threads < 1) {
+        usage();
+        return 2;
+    }
+    if (options.modes.empty())
+        options.modes = {TimerMode::SleepUntil, TimerMode::ClockNanosleep, TimerMode::HybridSpin};
+    if (options.antagonists.empty())
+        options.antagonists = {Antagonist::MemoryBandwidth, Antagonist::CacheThrash, Antagonist::SyscallStorm,
+                               Antagonist::PageFaults};
+    if (interference && options.rt.cpu >= 0) {
+        // Antagonists on the RT core would measure CPU sharing, not interference through shared resources
+        for (int cpu : options.antagonist_cpus) {
+            if (cpu == options.rt.cpu) {
+                fprintf(stderr, "--antagonist-cpus must not include the RT CPU %d\n", options.rt.cpu);
+                return 2;
+            }
+        }
+        if (options.antagonist_cpus.empty()) {
+            options.antagonist_cpus = antagonist_default_cpus(options.rt.cpu);
+            if (options.antagonist_cpus.empty())
+                fprintf(stderr, "warning: no CPU besides the RT CPU %d; antagonists will share it\n", options.rt.cpu);
+        }
+    }
+
+    BenchResults results;
+    results.host = bench_host_info();
+    results.timestamp = bench_timestamp();
+    for (int i = 0; i < argc; ++i)
+        results.command += (i == 0 ? "" : " ") + std::string(argv[i]);
+
+    const int status = interference ? run_interference(options, results) : run_latency(options, results);
+    if (status == 0 && options.json_path != nullptr && !results_write_json(options.json_path, results))
+        return 1;
+    return status;
+}
@@ -0,0 +1,536 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.h"
+
+/*
+ * Benchmark results as JSON files: one latency distribution per benchmark
+ * variant plus the host it ran on, and the statistics to compare two files.
+ *
+ *   {
+ *     "format": "spsc-bench-results", "version": 1,
+ *     "host": {"hostname": ..., "kernel": ..., "machine": ..., "cpu_model": ..., "cpus": N},
+ *     "timestamp": "2026-01-01T00:00:00Z", "command": "spsc_bench latency ...",
+ *     "series": [
+ *       {"name": "latency/nanosleep", "count": N, "min_us": .., "mean_us": .., "max_us": ..,
+ *        "buckets": [[us, count], ...]}
+ *     ]
+ *   }
+ *
+ * Buckets are the non-empty 1 us buckets of a LatencyHistogram; its overflow
+ * is stored as one last bucket at the histogram's size.
+ */
+
+static const char BENCH_RESULTS_FORMAT[] = "spsc-bench-results";
+static const int BENCH_RESULTS_VERSION = 1;
+
+/**
+ * @brief Where a benchmark ran.
+ */
+struct BenchHost {
+    std::string hostname;
+    std::string kernel;
+    std::string machine;
+    std::string cpu_model;
+    int cpus = 0;
+};
+
+/**
+ * @brief One latency distribution, named "<benchmark>/<variant>[/<metric>]".
+ */
+struct BenchSeries {
+    std::string name;
+    std::vector<std::pair<uint32_t, uint64_t>> buckets; // (lower bound in us, count), ascending
+    uint64_t count = 0;
+    double min_us = 0.0;
+    double mean_us = 0.0;
+    double max_us = 0.0;
+};
+
+/**
+ * @brief A whole results file.
+ */
+struct BenchResults {
+    BenchHost host;
+    std::string timestamp;
+    std::string command;
+    std::vector<BenchSeries> series;
+};
+
+/**
+ * @brief Describes the current host from uname(2) and /proc/cpuinfo
+ */
+inline BenchHost bench_host_info() {
+    BenchHost host;
+    struct utsname names;
+    if (uname(&names) == 0) {
+        host.hostname = names.nodename;
+        host.kernel = names.release;
+        host.machine = names.machine;
+    }
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (file != nullptr) {
+        char line[512];
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            const char *colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) == 0 && colon != nullptr) {
+                host.cpu_model = colon + 2;
+                while (!host.cpu_model.empty() && host.cpu_model.back() == '\n')
+                    host.cpu_model.pop_back();
+                break;
+            }
+        }
+        fclose(file);
+    }
+    host.cpus = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    return host;
+}
+
+/**
+ * @brief Converts a histogram into a series
+ */
+template <size_t Buckets>
+BenchSeries bench_series(const std::string &name, const LatencyHistogram<Buckets> &histogram) {
+    BenchSeries series;
+    series.name = name;
+    for (size_t b = 0; b < Buckets; ++b) {
+        if (histogram.buckets[b] > 0)
+            series.buckets.push_back({static_cast<uint32_t>(b), histogram.buckets[b]});
+    }
+    if (histogram.overflow > 0)
+        series.buckets.push_back({static_cast<uint32_t>(Buckets), histogram.overflow});
+    series.count = histogram.count;
+    if (histogram.count > 0) {
+        series.min_us = histogram.min_ns / 1000.0;
+        series.mean_us = histogram.sum_ns / static_cast<double>(histogram.count) / 1000.0;
+        series.max_us = histogram.max_ns / 1000.0;
+    }
+    return series;
+}
+
+/**
+ * @brief Latency in microseconds below which a fraction `q` of the series falls
+ *
+ * Like histogram_percentile_us(): the upper edge of the bucket, except in the
+ * last bucket (which may be the overflow), where the max is exact.
+ */
+inline double series_percentile_us(const BenchSeries &series, double q) {
+    if (series.count == 0)
+        return 0.0;
+    const double target = q * static_cast<double>(series.count);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < series.buckets.size(); ++i) {
+        seen += series.buckets[i].second;
+        if (static_cast<double>(seen) >= target)
+            return i + 1 == series.buckets.size() ? series.max_us : series.buckets[i].first + 1.0;
+    }
+    return series.max_us;
+}
+
+/**
+ * @brief Result of a one-sided Mann-Whitney U test.
+ */
+struct MannWhitney {
+    double effect = 0.5;  // P(candidate > baseline) + P(tie) / 2; 0.5 means no shift
+    double z = 0.0;       // normal approximation, tie-corrected
+    double p_value = 1.0; // probability of an effect this large if candidate is not slower
+};
+
+/**
+ * @brief Tests whether `candidate` tends to be slower than `baseline`
+ *
+ * Works directly on the bucketed distributions: samples in the same 1 us
+ * bucket are ties, which the variance correction accounts for. With the
+ * sample counts benchmarks produce, the normal approximation is exact enough.
+ */
+inline MannWhitney mann_whitney(const BenchSeries &baseline, const BenchSeries &candidate) {
+    MannWhitney result;
+    const double n1 = static_cast<double>(candidate.count);
+    const double n2 = static_cast<double>(baseline.count);
+    if (n1 == 0 || n2 == 0)
+        return result;
+
+    // Merge-walk both sorted bucket lists: U counts (candidate, baseline) pairs
+    // with candidate slower, plus half of the ties.
+    double u = 0.0, tie_sum = 0.0, baseline_below = 0.0;
+    size_t i = 0, j = 0;
+    while (i < candidate.buckets.size() || j < baseline.buckets.size()) {
+        const uint32_t c_key = i < candidate.buckets.size() ? candidate.buckets[i].first : UINT32_MAX;
+        const uint32_t b_key = j < baseline.buckets.size() ? baseline.buckets[j].first : UINT32_MAX;
+        const uint32_t key = c_key < b_key ? c_key : b_key;
+        const double c = c_key == key ? static_cast<double>(candidate.buckets[i++].second) : 0.0;
+        const double b = b_key == key ? static_cast<double>(baseline.buckets[j++].second) : 0.0;
+        u += c * (baseline_below + 0.5 * b);
+        baseline_below += b;
+        const double t = c + b;
+        tie_sum += t * t * t - t;
+    }
+
+    const double n = n1 + n2;
+    const double variance = n1 * n2 / 12.0 * ((n + 1.0) - tie_sum / (n * (n - 1.0)));
+    result.effect = u / (n1 * n2);
+    if (variance <= 0.0)
+        return result;
+    result.z = (u - n1 * n2 / 2.0) / sqrt(variance);
+    result.p_value = 0.5 * erfc(result.z / sqrt(2.0));
+    return result;
+}
+
+/**
+ * @brief Result of a one-sided test on the share of samples above the baseline's p99.
+ */
+struct TailTest {
+    uint32_t bucket = 0;          // samples in buckets above this one (the baseline's p99 bucket) count
+    double baseline_share = 0.0;
+    double candidate_share = 0.0;
+    double z = 0.0;               // two-proportion z statistic, pooled variance
+    double p_value = 1.0;         // probability of a share this much larger if the tail did not grow
+};
+
+/**
+ * @brief Tests whether more of `candidate` than of `baseline` lies above the baseline's p99
+ *
+ * The Mann-Whitney test weighs every sample equally, so a tail that blows up
+ * for 1-2% of the samples barely moves it. This compares the fraction of each
+ * series beyond the bucket holding the baseline's p99 with a one-sided
+ * two-proportion z-test instead.
+ */
+inline TailTest tail_test(const BenchSeries &baseline, const BenchSeries &candidate) {
+    TailTest result;
+    if (baseline.count == 0 || candidate.count == 0)
+        return result;
+
+    const double target = 0.99 * static_cast<double>(baseline.count);
+    uint64_t seen = 0;
+    for (const auto &bucket : baseline.buckets) {
+        seen += bucket.second;
+        result.bucket = bucket.first;
+        if (static_cast<double>(seen) >= target)
+            break;
+    }
+
+    auto above = [&result](const BenchSeries &series) {
+        uint64_t count = 0;
+        for (const auto &bucket : series.buckets)
+            count += bucket.first > result.bucket ? bucket.second : 0;
+        return static_cast<double>(count);
+    };
+    const double nb = static_cast<double>(baseline.count);
+    const double nc = static_cast<double>(candidate.count);
+    const double xb = above(baseline), xc = above(candidate);
+    result.baseline_share = xb / nb;
+    result.candidate_share = xc / nc;
+
+    const double pooled = (xb + xc) / (nb + nc);
+    const double variance = pooled * (1.0 - pooled) * (1.0 / nb + 1.0 / nc);
+    if (variance <= 0.0)
+        return result;
+    result.z = (result.candidate_share - result.baseline_share) / sqrt(variance);
+    result.p_value = 0.5 * erfc(result.z / sqrt(2.0));
+    return result;
+}
+
+/**
+ * @brief Current UTC time as ISO 8601
+ */
+inline std::string bench_timestamp() {
+    char text[32];
+    time_t now = time(nullptr);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+    return text;
+}
+
+inline void json_write_string(FILE *file, const std::string &text) {
+    fputc('"', file);
+    for (unsigned char ch : text) {
+        if (ch == '"' || ch == '\\')
+            fprintf(file, "\\%c", ch);
+        else if (ch < 0x20)
+            fprintf(file, "\\u%04x", ch);
+        else
+            fputc(ch, file);
+    }
+    fputc('"', file);
+}
+
+/**
+ * @brief Writes a results file
+ * @return false if the file cannot be written
+ */
+inline bool results_write_json(const char *path, const BenchResults &results) {
+    FILE *file = fopen(path, "w");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    fprintf(file, "{\n  \"format\": \"%s\",\n  \"version\": %d,\n  \"host\": {\"hostname\": ", BENCH_RESULTS_FORMAT,
+            BENCH_RESULTS_VERSION);
+    json_write_string(file, results.host.hostname);
+    fprintf(file, ", \"kernel\": ");
+    json_write_string(file, results.host.kernel);
+    fprintf(file, ", \"machine\": ");
+    json_write_string(file, results.host.machine);
+    fprintf(file, ", \"cpu_model\": ");
+    json_write_string(file, results.host.cpu_model);
+    fprintf(file, ", \"cpus\": %d},\n  \"timestamp\": ", results.host.cpus);
+    json_write_string(file, results.timestamp);
+    fprintf(file, ",\n  \"command\": ");
+    json_write_string(file, results.command);
+    fprintf(file, ",\n  \"series\": [");
+    for (size_t s = 0; s < results.series.size(); ++s) {
+        const BenchSeries &series = results.series[s];
+        fprintf(file, "%s\n    {\"name\": ", s == 0 ? "" : ",");
+        json_write_string(file, series.name);
+        fprintf(file, ", \"count\": %llu, \"min_us\": %.3f, \"mean_us\": %.3f, \"max_us\": %.3f,\n     \"buckets\": [",
+                static_cast<unsigned long long>(series.count), series.min_us, series.mean_us, series.max_us);
+        for (size_t b = 0; b < series.buckets.size(); ++b)
+            fprintf(file, "%s[%u, %llu]", b == 0 ? "" : ", ", series.buckets[b].first,
+                    static_cast<unsigned long long>(series.buckets[b].second));
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    const bool ok = !ferror(file);
+    return fclose(file) == 0 && ok;
+}
+
+/**
+ * @brief A parsed JSON value; just enough of JSON to read results files back.
+ */
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    double number = 0.0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue *get(const char *key) const {
+        for (const auto &member : members) {
+            if (member.first == key)
+                return &member.second;
+        }
+        return nullptr;
+    }
+};
+
+inline void json_skip_space(const char *&p) {
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        ++p;
+}
+
+inline bool json_parse_string(const char *&p, std::string &out) {
+    if (*p != '"')
+        return false;
+    ++p;
+    out.clear();
+    while (*p != '"') {
+        if (*p == '\0')
+            return false;
+        if (*p != '\\') {
+            out += *p++;
+            continue;
+        }
+        ++p;
+        switch (*p) {
+        case 'n':
+            out += '\n';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'u': {
+            // Only what json_write_string() produces: code points below 0x80
+            char *end = nullptr;
+            const std::string digits(p + 1, strnlen(p + 1, 4));
+            const long code = strtol(digits.c_str(), &end, 16);
+            if (digits.size() != 4 || *end != '\0')
+                return false;
+            out += code < 0x80 ? static_cast<char>(code) : '?';
+            p += 4;
+            break;
+        }
+        case '\0':
+            return false;
+        default:
+            out += *p;
+            break;
+        }
+        ++p;
+    }
+    ++p;
+    return true;
+}
+
+inline bool json_parse(const char *&p, JsonValue &out, int depth = 0) {
+    json_skip_space(p);
+    if (depth > 32)
+        return false;
+    if (*p == '{') {
+        out.type = JsonValue::Object;
+        ++p;
+        json_skip_space(p);
+        if (*p == '}') {
+            ++p;
+            return true;
+        }
+        for (;;) {
+            json_skip_space(p);
+            std::pair<std::string, JsonValue> member;
+            if (!json_parse_string(p, member.first))
+                return false;
+            json_skip_space(p);
+            if (*p++ != ':' || !json_parse(p, member.second, depth + 1))
+                return false;
+            out.members.push_back(std::move(member));
+            json_skip_space(p);
+            if (*p == '}') {
+                ++p;
+                return true;
+            }
+            if (*p++ != ',')
+                return false;
+        }
+    }
+    if (*p == '[') {
+        out.type = JsonValue::Array;
+        ++p;
+        json_skip_space(p);
+        if (*p == ']') {
+            ++p;
+            return true;
+        }
+        for (;;) {
+            out.items.emplace_back();
+            if (!json_parse(p, out.items.back(), depth + 1))
+                return false;
+            json_skip_space(p);
+            if (*p == ']') {
+                ++p;
+                return true;
+            }
+            if (*p++ != ',')
+                return false;
+        }
+    }
+    if (*p == '"') {
+        out.type = JsonValue::String;
+        return json_parse_string(p, out.text);
+    }
+    if (strncmp(p, "true", 4) == 0 || strncmp(p, "false", 5) == 0) {
+        out.type = JsonValue::Bool;
+        out.number = *p == 't' ? 1.0 : 0.0;
+        p += *p == 't' ? 4 : 5;
+        return true;
+    }
+    if (strncmp(p, "null", 4) == 0) {
+        out.type = JsonValue::Null;
+        p += 4;
+        return true;
+    }
+    char *end = nullptr;
+    out.number = strtod(p, &end);
+    if (end == p)
+        return false;
+    out.type = JsonValue::Number;
+    p = end;
+    return true;
+}
+
+inline std::string json_string(const JsonValue *value) {
+    return value != nullptr && value->type == JsonValue::String ? value->text : std::string();
+}
+
+inline double json_number(const JsonValue *value) {
+    return value != nullptr && value->type == JsonValue::Number ? value->number : 0.0;
+}
+
+/**
+ * @brief Reads a results file written by results_write_json()
+ * @return false if the file cannot be read or is not a results file
+ */
+inline bool results_read_json(const char *path, BenchResults &results) {
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        perror(path);
+        return false;
+    }
+    std::string text;
+    char chunk[65536];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        text.append(chunk, got);
+    fclose(file);
+
+    JsonValue root;
+    const char *p = text.c_str();
+    if (!json_parse(p, root) || root.type != JsonValue::Object ||
+        json_string(root.get("format")) != BENCH_RESULTS_FORMAT ||
+        json_number(root.get("version")) != BENCH_RESULTS_VERSION) {
+        fprintf(stderr, "%s: not a benchmark results file\n", path);
+        return false;
+    }
+
+    results = BenchResults();
+    if (const JsonValue *host = root.get("host")) {
+        results.host.hostname = json_string(host->get("hostname"));
+        results.host.kernel = json_string(host->get("kernel"));
+        results.host.machine = json_string(host->get("machine"));
+        results.host.cpu_model = json_string(host->get("cpu_model"));
+        results.host.cpus = static_cast<int>(json_number(host->get("cpus")));
+    }
+    results.timestamp = json_string(root.get("timestamp"));
+    results.command = json_string(root.get("command"));
+    const JsonValue *series = root.get("series");
+    if (series == nullptr || series->type != JsonValue::Array) {
+        fprintf(stderr, "%s: no series\n", path);
+        return false;
+    }
+    for (const JsonValue &item : series->items) {
+        BenchSeries entry;
+        entry.name = json_string(item.get("name"));
+        entry.count = static_cast<uint64_t>(json_number(item.get("count")));
+        entry.min_us = json_number(item.get("min_us"));
+        entry.mean_us = json_number(item.get("mean_us"));
+        entry.max_us = json_number(item.get("max_us"));
+        const JsonValue *buckets = item.get("buckets");
+        uint64_t total = 0;
+        for (size_t b = 0; buckets != nullptr && b < buckets->items.size(); ++b) {
+            const JsonValue &pair = buckets->items[b];
+            if (pair.items.size() != 2) {
+                fprintf(stderr, "%s: bad bucket in %s\n", path, entry.name.c_str());
+                return false;
+            }
+            entry.buckets.push_back(
+                {static_cast<uint32_t>(pair.items[0].number), static_cast<uint64_t>(pair.items[1].number)});
+            total += entry.buckets.back().second;
+        }
+        if (entry.name.empty() || total != entry.count) {
+            fprintf(stderr, "%s: inconsistent series '%s'\n", path, entry.name.c_str());
+            return false;
+        }
+        results.series.push_back(std::move(entry));
+    }
+    return true;
+}
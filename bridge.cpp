@@ -0,0 +1,288 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "quantile_sketch.h"
+#include "udp_bridge.h"
+
+/*
+ * spsc_bridge: carries the telemetry stream over UDP.
+ *
+ *   send NAME   drains the ExportRing that `spsc_app --export NAME` fills in
+ *               shared memory and sends it as batched datagrams (sendmmsg)
+ *   recv        receives datagrams (recvmmsg) into a local Ring and prints them
+ *   bench       runs producer, sender, receiver and consumer in one process
+ *               over loopback and reports rate, loss and added latency
+ */
+
+static std::atomic<bool> stop_requested{false};
+
+static void on_signal(int) {
+    stop_requested.store(true, std::memory_order_relaxed);
+}
+
+struct BridgeOptions {
+    std::string host = "127.0.0.1";
+    uint16_t port = 9750;
+    double seconds = 5.0;
+    double rate = 0.0; // samples per second, 0: as fast as possible
+    int poll_us = 50;
+};
+
+using Sender = BridgeSender<Message>;
+using Receiver = BridgeReceiver<Message>;
+using LocalRing = BasicRing<Sample<Message>, uint32_t, 4096>;
+
+/**
+ * @brief Splits "HOST:PORT" into the options
+ */
+static bool parse_endpoint(const char *text, BridgeOptions &options) {
+    const char *colon = strrchr(text, ':');
+    if (colon == nullptr)
+        return false;
+    options.host.assign(text, colon);
+    options.port = static_cast<uint16_t>(atoi(colon + 1));
+    return options.port != 0;
+}
+
+static void print_receiver_stats(const Receiver &receiver) {
+    printf("received %llu samples, lost %llu, stale datagrams %llu, ring overflows %llu\n",
+           static_cast<unsigned long long>(receiver.received), static_cast<unsigned long long>(receiver.lost),
+           static_cast<unsigned long long>(receiver.stale), static_cast<unsigned long long>(receiver.overflows));
+}
+
+/**
+ * @brief Bridges a shared-memory ExportRing to UDP until interrupted
+ */
+static int run_send(const char *name, const BridgeOptions &options) {
+    ExportRing *ring = shm_channel_attach<ExportRing>(name);
+    if (ring == nullptr) {
+        fprintf(stderr, "no export ring %s (start spsc_app --export %s first)\n", name, name);
+        return 1;
+    }
+    static Sender sender;
+    if (!bridge_sender_open(sender, options.host.c_str(), options.port)) {
+        fprintf(stderr, "cannot open UDP socket to %s:%u\n", options.host.c_str(), options.port);
+        return 1;
+    }
+
+    uint64_t samples = 0;
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+        ssize_t sent = bridge_send(sender, *ring);
+        if (sent > 0)
+            samples += static_cast<uint64_t>(sent);
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(options.poll_us));
+    }
+    printf("sent %llu samples in %llu datagrams, %llu send errors\n", static_cast<unsigned long long>(samples),
+           static_cast<unsigned long long>(sender.datagrams_sent), static_cast<unsigned long long>(sender.send_errors));
+    bridge_close(sender);
+    shm_channel_detach(ring);
+    return 0;
+}
+
+/**
+ * @brief Receives into a local Ring and prints every sample until interrupted
+ */
+static int run_recv(const BridgeOptions &options) {
+    static Receiver receiver;
+    static LocalRing ring;
+    if (!bridge_receiver_open(receiver, options.host.c_str(), options.port)) {
+        fprintf(stderr, "cannot bind %s:%u\n", options.host.c_str(), options.port);
+        return 1;
+    }
+
+    while (!stop_requested.load(std::memory_order_relaxed)) {
+        if (bridge_receive(receiver, ring) < 0) {
+            perror("recvmmsg");
+            break;
+        }
+        Sample<Message> sample;
+        while (try_pop(ring, sample)) {
+            printf("%llu %lld %f\n", static_cast<unsigned long long>(sample.cycle),
+                   static_cast<long long>(sample.time_ns), sample.msg.arrayOfNumbers[0]);
+        }
+        fflush(stdout);
+    }
+    print_receiver_stats(receiver);
+    bridge_close(receiver);
+    return 0;
+}
+
+/**
+ * @brief Loopback benchmark: producer -> ExportRing -> UDP -> local Ring -> consumer
+ *
+ * The producer stamps each sample as it pushes it; the consumer measures how
+ * long it took to come out of the local ring on the other side.
+ */
+static int run_bench(const BridgeOptions &options) {
+    static ExportRing export_ring;
+    static LocalRing local_ring;
+    static Sender sender;
+    static Receiver receiver;
+    if (!bridge_receiver_open(receiver, options.host.c_str(), options.port, 10)
+        || !bridge_sender_open(sender, options.host.c_str(), options.port)) {
+        fprintf(stderr, "cannot set up UDP on %s:%u\n", options.host.c_str(), options.port);
+        return 1;
+    }
+
+    std::atomic<bool> producing{true};
+    std::atomic<bool> sending{true};
+    std::atomic<bool> receiving{true};
+    uint64_t produced = 0;
+    uint64_t export_drops = 0;
+    uint64_t consumed = 0;
+    static QuantileSketch<> latency;
+    sketch_init(latency, 0.01);
+
+    std::thread producer([&] {
+        const auto start = std::chrono::steady_clock::now();
+        const auto end = start + std::chrono::duration<double>(options.seconds);
+        while (std::chrono::steady_clock::now() < end && !stop_requested.load(std::memory_order_relaxed)) {
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            uint64_t due = options.rate > 0 ? static_cast<uint64_t>(elapsed * options.rate) - produced : 1024;
+            for (; due > 0; --due) {
+                Sample<Message> sample{};
+                sample.cycle = produced;
+                sample.time_ns = realtime_now_ns();
+                sample.msg.arrayOfNumbers[0] = static_cast<float>(produced);
+                if (!try_push(export_ring, sample)) {
+                    if (options.rate > 0)
+                        export_drops += 1;
+                    else
+                        break;
+                }
+                produced += 1;
+            }
+            if (options.rate > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            else
+                std::this_thread::yield();
+        }
+        producing.store(false, std::memory_order_release);
+    });
+
+    std::thread send_thread([&] {
+        while (true) {
+            const bool last = !producing.load(std::memory_order_acquire);
+            ssize_t sent = bridge_send(sender, export_ring);
+            if (sent <= 0) {
+                if (last)
+                    break;
+                std::this_thread::sleep_for(std::chrono::microseconds(options.poll_us));
+            }
+        }
+        sending.store(false, std::memory_order_release);
+    });
+
+    std::thread receive_thread([&] {
+        // Stop once the sender is done and the socket has gone quiet; a full local ring still counts as traffic
+        while (true) {
+            ssize_t datagrams = bridge_receive(receiver, local_ring);
+            if (datagrams == 0 && !sending.load(std::memory_order_acquire))
+                break;
+        }
+        receiving.store(false, std::memory_order_release);
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    while (true) {
+        const bool last = !receiving.load(std::memory_order_acquire);
+        Sample<Message> sample;
+        bool any = false;
+        while (try_pop(local_ring, sample)) {
+            sketch_add(latency, static_cast<double>(realtime_now_ns() - sample.time_ns) / 1000.0);
+            consumed += 1;
+            any = true;
+        }
+        if (last && !any)
+            break;
+        if (!any)
+            std::this_thread::sleep_for(std::chrono::microseconds(options.poll_us));
+    }
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    producer.join();
+    send_thread.join();
+    receive_thread.join();
+
+    printf("samples: produced %llu, consumed %llu (%.0f/s), export ring drops %llu\n",
+           static_cast<unsigned long long>(produced), static_cast<unsigned long long>(consumed),
+           static_cast<double>(consumed) / elapsed, static_cast<unsigned long long>(export_drops));
+    printf("datagrams: %llu sent, %.1f samples each\n", static_cast<unsigned long long>(sender.datagrams_sent),
+           sender.datagrams_sent > 0 ? static_cast<double>(produced - export_drops) / sender.datagrams_sent : 0.0);
+    print_receiver_stats(receiver);
+    printf("added latency (us): p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+           sketch_quantile(latency, 0.50), sketch_quantile(latency, 0.90), sketch_quantile(latency, 0.99),
+           sketch_quantile(latency, 0.999), latency.max);
+
+    bridge_close(sender);
+    bridge_close(receiver);
+    return 0;
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: spsc_bridge send NAME [--to HOST:PORT] [--poll-us N]\n"
+            "       spsc_bridge recv [--listen HOST:PORT]\n"
+            "       spsc_bridge bench [--port N] [--seconds S] [--rate SAMPLES_PER_S] [--poll-us N]\n"
+            "  NAME is the shared-memory name given to spsc_app --export. Default endpoint 127.0.0.1:9750.\n");
+}
+
+/**
+ * @brief Entry point of the bridge tool
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    const std::string mode = argv[1];
+    const char *name = nullptr;
+    int first = 2;
+    if (mode == "send") {
+        if (argc < 3) {
+            usage();
+            return 2;
+        }
+        name = argv[2];
+        first = 3;
+    }
+
+    BridgeOptions options;
+    for (int i = first; i < argc; ++i) {
+        if ((strcmp(argv[i], "--to") == 0 || strcmp(argv[i], "--listen") == 0) && i + 1 < argc) {
+            if (!parse_endpoint(argv[++i], options)) {
+                usage();
+                return 2;
+            }
+        } else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            options.port = static_cast<uint16_t>(atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            options.seconds = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            options.rate = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--poll-us") == 0 && i + 1 < argc) {
+            options.poll_us = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    if (mode == "send")
+        return run_send(name, options);
+    if (mode == "recv")
+        return run_recv(options);
+    if (mode == "bench")
+        return run_bench(options);
+    usage();
+    return 2;
+}
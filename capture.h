@@ -0,0 +1,236 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+
+#include "telemetry.h"
+
+/**
+ * @brief What fired a TriggeredCapture.
+ */
+enum TriggerSource : uint32_t {
+    TRIGGER_NONE = 0,
+    TRIGGER_THRESHOLD = 1,
+    TRIGGER_FAULT = 2,
+    TRIGGER_COMMAND = 3,
+};
+
+/**
+ * @brief A frozen window of full-rate samples around one trigger.
+ *
+ * `samples[0 .. pre_count)` are the samples before the trigger, oldest first;
+ * `samples[pre_count]` is the sample that fired the trigger, followed by the
+ * post-trigger samples.
+ */
+template <typename Msg, size_t Pre, size_t Post>
+struct CaptureBuffer {
+    uint32_t source;
+    uint64_t trigger_cycle;
+    size_t pre_count;
+    size_t count;
+    Sample<Msg> samples[Pre + Post];
+};
+
+/**
+ * @brief Oscilloscope-style capture stage that runs on the RT thread.
+ *
+ * Every cycle the RT thread records its sample into a private, lossy history
+ * of the last `Pre` samples. When a trigger fires (a threshold on one axis, a
+ * fault flag from the control code, or a request from the Observer) the
+ * history is frozen into `buffer`, the next `Post` samples are appended, and
+ * the buffer is handed to the Observer, which exports it at its own pace and
+ * hands it back with capture_release(). Triggers that fire while the buffer
+ * is still owned by the Observer are counted in `missed_triggers`.
+ *
+ * The threshold trigger is edge-triggered: it fires when the axis magnitude
+ * rises above `threshold` and re-arms only once it has dropped back to
+ * `threshold - hysteresis` or below, so one long excursion fires (or is
+ * missed) once. An excursion that starts while a capture is still collecting
+ * belongs to that capture.
+ */
+template <typename Msg, size_t Pre, size_t Post>
+struct TriggeredCapture {
+    static_assert(Post > 0, "A capture needs at least the trigger sample.");
+
+    using T = typename Msg::value_type;
+
+    // Configuration, set with capture_set_threshold() before the RT thread starts
+    bool threshold_enabled = false;
+    size_t threshold_axis = 0;
+    T threshold = T{};
+    T hysteresis = T{};
+
+    // Observer -> RT
+    alignas(64) std::atomic<bool> command_trigger{false};
+
+    // RT -> Observer: true while `buffer` belongs to the Observer
+    alignas(64) std::atomic<bool> ready{false};
+
+    // RT-private state
+    alignas(64) Sample<Msg> history[Pre > 0 ? Pre : 1];
+    size_t history_count = 0;
+    size_t history_pos = 0;
+    bool collecting = false;
+    bool threshold_armed = true;
+    uint64_t missed_triggers = 0;
+
+    CaptureBuffer<Msg, Pre, Post> buffer;
+};
+
+/**
+ * @brief Enables the threshold trigger, before the RT thread starts
+ * @param capture The capture stage
+ * @param axis Index of the field to watch, below Msg::axes
+ * @param threshold Magnitude above which the trigger fires
+ * @param hysteresis How far the magnitude must fall below `threshold` to re-arm; not negative
+ * @return false (and the trigger stays as it was) if the settings are invalid
+ */
+template <typename Msg, size_t Pre, size_t Post>
+bool capture_set_threshold(TriggeredCapture<Msg, Pre, Post> &capture, size_t axis, typename Msg::value_type threshold,
+                           typename Msg::value_type hysteresis) {
+    using T = typename Msg::value_type;
+    if (axis >= Msg::axes || !(hysteresis >= T{}) || !(threshold == threshold))
+        return false;
+    capture.threshold_axis = axis;
+    capture.threshold = threshold;
+    capture.hysteresis = hysteresis;
+    capture.threshold_armed = true;
+    capture.threshold_enabled = true;
+    return true;
+}
+
+/**
+ * @brief Asks the RT thread to trigger a capture on its next cycle
+ * @param capture The capture stage
+ */
+template <typename Msg, size_t Pre, size_t Post>
+void capture_request(TriggeredCapture<Msg, Pre, Post> &capture) {
+    capture.command_trigger.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records this cycle's sample on the RT thread and evaluates the triggers
+ * @param capture The capture stage
+ * @param sample This cycle's sample
+ * @param fault Whether the control code flagged a fault this cycle
+ * @return true if a capture buffer was completed this cycle
+ */
+template <typename Msg, size_t Pre, size_t Post>
+bool capture_record(TriggeredCapture<Msg, Pre, Post> &capture, const Sample<Msg> &sample, bool fault) {
+    using T = typename Msg::value_type;
+    auto &buffer = capture.buffer;
+    bool completed = false;
+
+    bool threshold_edge = false;
+    if (capture.threshold_enabled && capture.threshold_axis < Msg::axes) {
+        const T v = sample.msg.arrayOfNumbers[capture.threshold_axis];
+        const T magnitude = v < T{} ? -v : v;
+        if (capture.threshold_armed && magnitude > capture.threshold) {
+            threshold_edge = true;
+            capture.threshold_armed = false;
+        } else if (!capture.threshold_armed && magnitude <= capture.threshold - capture.hysteresis) {
+            capture.threshold_armed = true;
+        }
+    }
+
+    if (capture.collecting) {
+        buffer.samples[buffer.count++] = sample;
+        if (buffer.count == buffer.pre_count + Post) {
+            capture.collecting = false;
+            capture.ready.store(true, std::memory_order_release);
+            completed = true;
+        }
+    } else {
+        uint32_t source = TRIGGER_NONE;
+        if (capture.command_trigger.exchange(false, std::memory_order_relaxed))
+            source = TRIGGER_COMMAND;
+        else if (fault)
+            source = TRIGGER_FAULT;
+        else if (threshold_edge)
+            source = TRIGGER_THRESHOLD;
+
+        if (source != TRIGGER_NONE && capture.ready.load(std::memory_order_acquire)) {
+            capture.missed_triggers += 1;
+        } else if (source != TRIGGER_NONE) {
+            // Freeze the history, oldest first
+            if constexpr (Pre > 0) {
+                const size_t start = capture.history_pos + Pre - capture.history_count;
+                for (size_t i = 0; i < capture.history_count; ++i)
+                    buffer.samples[i] = capture.history[(start + i) % Pre];
+            }
+
+            buffer.source = source;
+            buffer.trigger_cycle = sample.cycle;
+            buffer.pre_count = capture.history_count;
+            buffer.count = capture.history_count;
+            buffer.samples[buffer.count++] = sample;
+
+            if (buffer.count == buffer.pre_count + Post) {
+                capture.ready.store(true, std::memory_order_release);
+                completed = true;
+            } else {
+                capture.collecting = true;
+            }
+        }
+    }
+
+    if constexpr (Pre > 0) {
+        capture.history[capture.history_pos] = sample;
+        capture.history_pos = (capture.history_pos + 1) % Pre;
+        if (capture.history_count < Pre)
+            capture.history_count += 1;
+    }
+    return completed;
+}
+
+/**
+ * @brief Returns the completed capture if there is one, for the Observer to export
+ * @param capture The capture stage
+ * @return The capture buffer, or nullptr if no capture is ready
+ */
+template <typename Msg, size_t Pre, size_t Post>
+const CaptureBuffer<Msg, Pre, Post> *capture_ready(TriggeredCapture<Msg, Pre, Post> &capture) {
+    if (!capture.ready.load(std::memory_order_acquire))
+        return nullptr;
+    return &capture.buffer;
+}
+
+/**
+ * @brief Hands an exported capture buffer back to the RT thread
+ * @param capture The capture stage
+ */
+template <typename Msg, size_t Pre, size_t Post>
+void capture_release(TriggeredCapture<Msg, Pre, Post> &capture) {
+    capture.ready.store(false, std::memory_order_release);
+}
+
+/**
+ * @brief Writes a capture as CSV, one line per sample
+ *
+ * The `offset` column is the position relative to the trigger sample.
+ *
+ * @param buffer The capture to export
+ * @param out The stream to write to
+ * @return true if everything was written
+ */
+template <typename Msg, size_t Pre, size_t Post>
+bool capture_write_csv(const CaptureBuffer<Msg, Pre, Post> &buffer, FILE *out) {
+    fprintf(out, "# source=%u trigger_cycle=%llu\n", buffer.source,
+            static_cast<unsigned long long>(buffer.trigger_cycle));
+    fprintf(out, "offset,cycle");
+    for (size_t a = 0; a < Msg::axes; ++a)
+        fprintf(out, ",axis%zu", a);
+    fprintf(out, "\n");
+
+    for (size_t i = 0; i < buffer.count; ++i) {
+        const auto &sample = buffer.samples[i];
+        fprintf(out, "%lld,%llu", static_cast<long long>(i) - static_cast<long long>(buffer.pre_count),
+                static_cast<unsigned long long>(sample.cycle));
+        for (size_t a = 0; a < Msg::axes; ++a)
+            fprintf(out, ",%g", static_cast<double>(sample.msg.arrayOfNumbers[a]));
+        fprintf(out, "\n");
+    }
+    return ferror(out) == 0;
+}
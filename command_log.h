@@ -0,0 +1,168 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+
+#include "magic_ring.h"
+#include "spsc.h"
+
+/*
+ * Command log file format
+ *
+ * A CommandLogHeader followed by one CommandRecord per command, in the order
+ * the RT thread observed them. Together with the RT logic this is everything
+ * needed to re-execute a run in virtual time (see spsc_replay).
+ */
+
+constexpr uint32_t COMMAND_LOG_MAGIC = 0x4c444d43; // "CMDL"
+constexpr uint32_t COMMAND_LOG_VERSION = 1;
+
+// Default size of the RT -> Observer byte ring; one page holds 73 records of eight-axis commands
+constexpr size_t COMMAND_LOG_RING_BYTES = 4096;
+
+struct CommandLogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size; // sizeof(CommandRecord<Msg>), guards against layout mismatches
+    uint32_t reserved;
+};
+
+/**
+ * @brief A command together with the RT cycle at which peek() first returned it.
+ */
+template <typename Msg>
+struct CommandRecord {
+    uint64_t cycle;
+    uint64_t sequence; // the mailbox sequence number of the command
+    Msg command;
+};
+
+/**
+ * @brief RT -> Observer channel that carries every newly observed command.
+ *
+ * The RT thread peeks through command_log_peek(), which notices a new mailbox
+ * sequence number and pushes the command with the current cycle. `overflows`
+ * counts commands that could not be logged because the Observer fell behind;
+ * a log with overflows cannot be replayed faithfully.
+ *
+ * The records travel as a byte stream through a MagicRing, so the Observer
+ * writes everything pending with one write() even across the wrap point, and
+ * a short write simply leaves the rest of the stream for the next drain.
+ * Set it up with command_log_init() before the RT thread starts.
+ */
+template <typename Msg>
+struct CommandLog {
+    MagicRing ring;
+
+    // RT-thread private
+    uint64_t last_sequence = 0;
+
+    alignas(64) std::atomic<uint64_t> overflows{0};
+};
+
+/**
+ * @brief Maps the log's ring
+ * @param log The log to set up
+ * @param capacity Size of the ring in bytes; a power of two and a multiple of the page size
+ * @return false if the ring could not be mapped
+ */
+template <typename Msg>
+bool command_log_init(CommandLog<Msg> &log, size_t capacity = COMMAND_LOG_RING_BYTES) {
+    log.last_sequence = 0;
+    log.overflows.store(0, std::memory_order_relaxed);
+    return magic_ring_create(log.ring, capacity);
+}
+
+/**
+ * @brief Unmaps the log's ring once both threads are done with it
+ */
+template <typename Msg>
+void command_log_destroy(CommandLog<Msg> &log) {
+    magic_ring_destroy(log.ring);
+}
+
+/**
+ * @brief Peeks at the mailbox and logs the command if it was not seen before (RT thread)
+ * @param log The log to append to
+ * @param mailbox The mailbox to peek from
+ * @param cycle The current RT cycle
+ * @return A copy of the latest, complete message
+ */
+template <typename Msg>
+Msg command_log_peek(CommandLog<Msg> &log, BasicMailbox<Msg> &mailbox, uint64_t cycle) {
+    uint64_t sequence;
+    Msg command = peek(mailbox, sequence);
+    if (sequence != log.last_sequence) {
+        log.last_sequence = sequence;
+        const CommandRecord<Msg> record{cycle, sequence, command};
+        if (!magic_ring_try_push(log.ring, &record, sizeof(record)))
+            log.overflows.fetch_add(1, std::memory_order_relaxed);
+    }
+    return command;
+}
+
+/**
+ * @brief Creates a command log file and writes its header
+ * @param path Path of the log file
+ * @return The file descriptor, or -1 on failure
+ */
+template <typename Msg>
+int command_log_create(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return -1;
+
+    CommandLogHeader header = {COMMAND_LOG_MAGIC, COMMAND_LOG_VERSION, sizeof(CommandRecord<Msg>), 0};
+    if (write(fd, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Writes every logged command to the log file (Observer thread)
+ * @param log The log to drain
+ * @param fd A file created with command_log_create()
+ * @return true unless a write failed
+ */
+template <typename Msg>
+bool command_log_drain(CommandLog<Msg> &log, int fd) {
+    ssize_t drained;
+    while ((drained = magic_ring_drain_to_fd(log.ring, fd, log.ring.capacity)) > 0) {
+    }
+    return drained == 0;
+}
+
+/**
+ * @brief Reads a whole command log
+ * @param path Path of the log file
+ * @param[out] records The commands in the order they were observed
+ * @return true if the file is a command log for this message type
+ */
+template <typename Msg>
+bool command_log_load(const char *path, std::vector<CommandRecord<Msg>> &records) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    CommandLogHeader header;
+    if (read(fd, &header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))
+        || header.magic != COMMAND_LOG_MAGIC || header.version != COMMAND_LOG_VERSION
+        || header.record_size != sizeof(CommandRecord<Msg>)) {
+        close(fd);
+        return false;
+    }
+
+    records.clear();
+    CommandRecord<Msg> record;
+    while (read(fd, &record, sizeof(record)) == static_cast<ssize_t>(sizeof(record)))
+        records.push_back(record);
+    close(fd);
+    return true;
+}
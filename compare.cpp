@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "bench_results.h"
+
+/*
+ * spsc_compare: checks a benchmark run against a baseline.
+ *
+ *   spsc_compare BASELINE.json CANDIDATE.json [--alpha A] [--threshold PCT]
+ *
+ * Both files come from `spsc_bench ... --json PATH`. Series with the same name
+ * (one per benchmark variant, e.g. latency/hybrid or interference/membw/ring)
+ * are compared with a one-sided Mann-Whitney U test on their distributions,
+ * and with a one-sided two-proportion test on the share of samples above the
+ * baseline's p99, which catches a tail that blows up while the bulk stays put.
+ * A series is a regression when either test is significant (p < alpha) and
+ * its p50 or p99 grew by more than PCT percent and by more than the 1 us
+ * bucket width; large runs make tiny shifts significant, and the threshold
+ * keeps those from failing a build. A run that is faster overall but has a
+ * worse p50 or p99 without a significantly heavier tail is reported as mixed.
+ * Exits 1 if anything regressed.
+ */
+
+struct CompareOptions {
+    double alpha = 0.01;
+    double threshold_pct = 5.0;
+};
+
+static void print_run(const char *label, const char *path, const BenchResults &results) {
+    printf("%-9s %s: %s, %s %s, %s, %d cpus, %s\n          %s\n", label, path, results.host.hostname.c_str(),
+           results.host.kernel.c_str(), results.host.machine.c_str(), results.host.cpu_model.c_str(),
+           results.host.cpus, results.timestamp.c_str(), results.command.c_str());
+}
+
+static const BenchSeries *find_series(const BenchResults &results, const std::string &name) {
+    for (const BenchSeries &series : results.series) {
+        if (series.name == name)
+            return &series;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Whether `candidate` exceeds `baseline` by more than the threshold and one bucket
+ */
+static bool grew(double baseline, double candidate, const CompareOptions &options) {
+    const double delta = candidate - baseline;
+    return delta > 1.0 && delta > baseline * options.threshold_pct / 100.0;
+}
+
+/**
+ * @brief Compares one series and prints its row
+ * @return true if it is a regression
+ */
+static bool compare_series(const BenchSeries &baseline, const BenchSeries &candidate, const CompareOptions &options) {
+    const MannWhitney test = mann_whitney(baseline, candidate);
+    const TailTest tail = tail_test(baseline, candidate);
+    const double base_p50 = series_percentile_us(baseline, 0.50);
+    const double cand_p50 = series_percentile_us(candidate, 0.50);
+    const double base_p99 = series_percentile_us(baseline, 0.99);
+    const double cand_p99 = series_percentile_us(candidate, 0.99);
+
+    const bool slower = grew(base_p50, cand_p50, options) || grew(base_p99, cand_p99, options);
+    const bool faster = grew(cand_p50, base_p50, options) || grew(cand_p99, base_p99, options);
+    const char *verdict = "same";
+    bool regression = false;
+    if ((test.p_value < options.alpha || tail.p_value < options.alpha) && slower) {
+        verdict = "REGRESSION";
+        regression = true;
+    } else if (1.0 - test.p_value < options.alpha) {
+        // Significantly faster overall, but a percentile may still have moved the other way
+        verdict = slower ? "mixed" : faster ? "improved" : "same";
+    }
+    printf("%-32s %8llu %8llu %7.0f %7.0f %7.0f %7.0f %9.1f %9.1f %6.3f %9.2g %6.2f%% %9.2g  %s\n",
+           baseline.name.c_str(), static_cast<unsigned long long>(baseline.count),
+           static_cast<unsigned long long>(candidate.count), base_p50, cand_p50, base_p99, cand_p99, baseline.max_us,
+           candidate.max_us, test.effect, test.p_value, 100.0 * tail.candidate_share, tail.p_value, verdict);
+    return regression;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: spsc_compare BASELINE.json CANDIDATE.json [--alpha A] [--threshold PCT]\n");
+}
+
+/**
+ * @brief Entry point of the comparison tool
+ */
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        usage();
+        return 2;
+    }
+    CompareOptions options;
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "--alpha") == 0 && i + 1 < argc) {
+            options.alpha = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            options.threshold_pct = strtod(argv[++i], nullptr);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (options.alpha <= 0.0 || options.alpha >= 1.0 || options.threshold_pct < 0.0) {
+        usage();
+        return 2;
+    }
+
+    BenchResults baseline, candidate;
+    if (!results_read_json(argv[1], baseline) || !results_read_json(argv[2], candidate))
+        return 2;
+
+    print_run("baseline", argv[1], baseline);
+    print_run("candidate", argv[2], candidate);
+    if (baseline.host.hostname != candidate.host.hostname || baseline.host.kernel != candidate.host.kernel ||
+        baseline.host.cpu_model != candidate.host.cpu_model || baseline.host.cpus != candidate.host.cpus)
+        printf("warning: the runs come from different hosts; differences may not be the code's\n");
+    printf("\n%-32s %17s %15s %15s %19s %16s %17s\n", "", "samples", "p50 (us)", "p99 (us)", "max (us)",
+           "Mann-Whitney", "tail > base p99");
+    printf("%-32s %8s %8s %7s %7s %7s %7s %9s %9s %6s %9s %7s %9s  %s\n", "series", "base", "cand", "base", "cand",
+           "base", "cand", "base", "cand", "P(c>b)", "p-value", "cand", "p-value", "verdict");
+
+    std::vector<std::string> regressions;
+    for (const BenchSeries &series : baseline.series) {
+        const BenchSeries *other = find_series(candidate, series.name);
+        if (other == nullptr) {
+            printf("%-32s missing from candidate\n", series.name.c_str());
+            continue;
+        }
+        if (compare_series(series, *other, options))
+            regressions.push_back(series.name);
+    }
+    for (const BenchSeries &series : candidate.series) {
+        if (find_series(baseline, series.name) == nullptr)
+            printf("%-32s new in candidate\n", series.name.c_str());
+    }
+
+    if (regressions.empty()) {
+        printf("\nno significant regressions (alpha %g, threshold %.1f%%)\n", options.alpha, options.threshold_pct);
+        return 0;
+    }
+    printf("\n%zu regression(s) (alpha %g, threshold %.1f%%):", regressions.size(), options.alpha,
+           options.threshold_pct);
+    for (const std::string &name : regressions)
+        printf(" %s", name.c_str());
+    printf("\n");
+    return 1;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "simd.h"
+#include "telemetry.h"
+
+/**
+ * @brief RT-side state for send-on-delta (deadband) telemetry.
+ *
+ * Instead of pushing a sample every cycle, the RT thread only pushes when some
+ * axis moved by more than its deadband since the last sample that was sent,
+ * when keepRunning changed, or when `keepalive_cycles` cycles passed without
+ * sending anything. While the robot is stationary this cuts ring and recorder
+ * bandwidth down to one sample per keep-alive interval. An axis turning NaN,
+ * or recovering from NaN, always counts as a change.
+ *
+ * The decision and the new reference are separate steps: the RT thread calls
+ * deadband_should_send(), pushes, and only calls deadband_commit() once the
+ * push succeeded. A sample dropped by a full ring is then retried on the next
+ * cycle instead of leaving the Observer with a stale value.
+ */
+template <typename Msg>
+struct DeadbandFilter {
+    using T = typename Msg::value_type;
+
+    T deadband[Msg::axes];
+    uint64_t keepalive_cycles;
+
+    // RT-private state
+    Msg last_sent;
+    uint64_t last_sent_cycle = 0;
+    bool primed = false;
+};
+
+/**
+ * @brief Sets the same deadband on every axis
+ * @param filter The filter to configure
+ * @param deadband Largest change per axis that is not reported
+ * @param keepalive_cycles Send at least one sample every this many cycles
+ */
+template <typename Msg>
+void deadband_init(DeadbandFilter<Msg> &filter, typename Msg::value_type deadband, uint64_t keepalive_cycles) {
+    for (auto &band : filter.deadband)
+        band = deadband;
+    filter.keepalive_cycles = keepalive_cycles;
+    filter.primed = false;
+}
+
+/**
+ * @brief Decides on the RT thread whether this cycle's message has to be sent
+ *
+ * Does not change the filter; call deadband_commit() after the push succeeded.
+ *
+ * @param filter The filter state
+ * @param message This cycle's data message
+ * @param cycle This cycle's number
+ * @return true if the message should be pushed
+ */
+template <typename Msg>
+bool deadband_should_send(const DeadbandFilter<Msg> &filter, const Msg &message, uint64_t cycle) {
+    return !filter.primed
+        || cycle - filter.last_sent_cycle >= filter.keepalive_cycles
+        || message.keepRunning != filter.last_sent.keepRunning
+        || any_abs_diff_exceeds(message.arrayOfNumbers, filter.last_sent.arrayOfNumbers,
+                                filter.deadband, Msg::axes);
+}
+
+/**
+ * @brief Makes a message that reached the Observer the new reference (RT thread)
+ * @param filter The filter state
+ * @param message The message that was pushed
+ * @param cycle The cycle it was pushed in
+ */
+template <typename Msg>
+void deadband_commit(DeadbandFilter<Msg> &filter, const Msg &message, uint64_t cycle) {
+    filter.last_sent = message;
+    filter.last_sent_cycle = cycle;
+    filter.primed = true;
+}
+
+/**
+ * @brief Observer-side state for expanding a deadband stream back to one sample per cycle.
+ */
+template <typename Msg>
+struct DeadbandReconstructor {
+    Sample<Msg> held;
+    bool primed = false;
+};
+
+/**
+ * @brief Feeds one received sample and emits the full per-cycle stream up to it
+ *
+ * Every cycle between the previous sample and this one is emitted as a copy
+ * of the previous sample (the value was within the deadband), followed by the
+ * new sample itself. Cycles after the most recent sample are not emitted until
+ * the next sample (at the latest the keep-alive) arrives.
+ *
+ * @param rebuild The reconstructor state
+ * @param sample The sample popped from the channel
+ * @param on_sample Called as on_sample(const Sample<Msg> &) for each cycle
+ */
+template <typename Msg, typename OnSample>
+void deadband_reconstruct(DeadbandReconstructor<Msg> &rebuild, const Sample<Msg> &sample, OnSample &&on_sample) {
+    if (rebuild.primed) {
+        Sample<Msg> fill = rebuild.held;
+        for (uint64_t c = rebuild.held.cycle + 1; c < sample.cycle; ++c) {
+            fill.cycle = c;
+            on_sample(fill);
+        }
+    }
+    on_sample(sample);
+    rebuild.held = sample;
+    rebuild.primed = true;
+}
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Asynchronous, page-cache-bypassing append-only file writer.
+ *
+ * Data is collected into `depth` aligned buffers of `buffer_bytes` each. A
+ * full buffer is written with O_DIRECT while the next one is being filled, so
+ * several writes are in flight at once and recording never evicts the RT
+ * process's working set from the page cache. Writes are issued through
+ * io_uring (set up with raw syscalls, no liburing) when the kernel allows it,
+ * and through a small pwrite thread pool otherwise. On filesystems without
+ * O_DIRECT support (e.g. tmpfs) the file is opened normally.
+ */
+
+constexpr size_t DIRECT_ALIGNMENT = 4096;
+
+enum DirectBackend {
+    DIRECT_BACKEND_IO_URING,
+    DIRECT_BACKEND_THREAD_POOL,
+};
+
+enum DirectBufferState {
+    BUFFER_FREE,
+    BUFFER_FILLING,
+    BUFFER_IN_FLIGHT,
+};
+
+struct DirectBuffer {
+    uint8_t *data = nullptr;
+    size_t len = 0;       // bytes submitted (padded to DIRECT_ALIGNMENT)
+    uint64_t offset = 0;  // file offset of data[0]
+    int state = BUFFER_FREE;
+};
+
+/**
+ * @brief Raw-syscall io_uring instance: just enough to submit writes and reap completions.
+ */
+struct IoUring {
+    int fd = -1;
+    void *sq_map = nullptr;
+    size_t sq_map_len = 0;
+    void *cq_map = nullptr;
+    size_t cq_map_len = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_len = 0;
+
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    io_uring_cqe *cqes = nullptr;
+};
+
+struct DirectWriter {
+    int fd = -1;
+    bool direct = false;
+    int backend = DIRECT_BACKEND_THREAD_POOL;
+    std::atomic<bool> failed{false}; // set by pool workers, read by the appending thread
+
+    size_t buffer_bytes = 0;
+    std::vector<DirectBuffer> buffers;
+    size_t current = 0;
+    uint64_t size = 0; // logical bytes appended so far
+
+    IoUring ring;
+
+    // Thread-pool backend; also guards buffer states for it
+    std::vector<std::thread> pool;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::deque<size_t> jobs;
+    bool stop = false;
+};
+
+inline bool io_uring_init(IoUring &ring, unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0)
+        return false;
+
+    ring.fd = fd;
+    ring.sq_map_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cq_map_len = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring.cq_map_len > ring.sq_map_len)
+            ring.sq_map_len = ring.cq_map_len;
+        ring.cq_map_len = ring.sq_map_len;
+    }
+
+    ring.sq_map = mmap(nullptr, ring.sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring.sq_map == MAP_FAILED) {
+        close(fd);
+        ring.fd = -1;
+        return false;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring.cq_map = ring.sq_map;
+    } else {
+        ring.cq_map = mmap(nullptr, ring.cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring.cq_map == MAP_FAILED) {
+            munmap(ring.sq_map, ring.sq_map_len);
+            close(fd);
+            ring.fd = -1;
+            return false;
+        }
+    }
+    ring.sqes_len = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, ring.sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        if (ring.cq_map != ring.sq_map)
+            munmap(ring.cq_map, ring.cq_map_len);
+        munmap(ring.sq_map, ring.sq_map_len);
+        close(fd);
+        ring.fd = -1;
+        return false;
+    }
+    ring.sqes = static_cast<io_uring_sqe *>(sqes);
+
+    uint8_t *sq = static_cast<uint8_t *>(ring.sq_map);
+    uint8_t *cq = static_cast<uint8_t *>(ring.cq_map);
+    ring.sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    ring.sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    ring.sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    ring.sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    ring.cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    ring.cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    ring.cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    ring.cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    return true;
+}
+
+/**
+ * @brief Whether the kernel behind `ring` implements IORING_OP_WRITE
+ *
+ * Kernels that can set up a ring may still predate this opcode; every write
+ * would then complete with -EINVAL, so the caller falls back instead.
+ */
+inline bool io_uring_supports_write(const IoUring &ring) {
+    const unsigned ops = IORING_OP_WRITE + 1;
+    std::vector<uint8_t> memory(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op), 0);
+    io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(memory.data());
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, ops) < 0)
+        return false;
+    return probe->ops_len > IORING_OP_WRITE && (probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+inline void io_uring_exit(IoUring &ring) {
+    if (ring.fd < 0)
+        return;
+    munmap(ring.sqes, ring.sqes_len);
+    if (ring.cq_map != ring.sq_map)
+        munmap(ring.cq_map, ring.cq_map_len);
+    munmap(ring.sq_map, ring.sq_map_len);
+    close(ring.fd);
+    ring.fd = -1;
+}
+
+/**
+ * @brief Queues one write in the submission ring without telling the kernel yet
+ *
+ * Once queued, the SQE belongs to the kernel: it will be consumed by the next
+ * io_uring_enter, so its buffer must stay in flight until its completion is
+ * reaped. Call io_uring_flush() to submit it.
+ *
+ * @return false if the submission ring is full; nothing was queued then
+ */
+inline bool io_uring_queue_write(IoUring &ring, int fd, const void *data, size_t len, uint64_t offset, uint64_t tag) {
+    const unsigned tail = *ring.sq_tail;
+    if (tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE) > *ring.sq_mask)
+        return false;
+    const unsigned idx = tail & *ring.sq_mask;
+    io_uring_sqe *sqe = &ring.sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(data);
+    sqe->len = static_cast<uint32_t>(len);
+    sqe->off = offset;
+    sqe->user_data = tag;
+    ring.sq_array[idx] = idx;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Writes the part of a buffer the kernel did not take, synchronously
+ *
+ * With O_DIRECT every write must start on a block boundary, so after a short
+ * write the tail is resubmitted from the last whole block; rewriting those
+ * bytes at the same offset is harmless.
+ */
+inline bool direct_finish_short_write(DirectWriter &writer, const DirectBuffer &buffer, size_t done) {
+    if (writer.direct)
+        done = done / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+    while (done < buffer.len) {
+        ssize_t n = pwrite(writer.fd, buffer.data + done, buffer.len - done, static_cast<off_t>(buffer.offset + done));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        size_t next = done + static_cast<size_t>(n);
+        if (writer.direct)
+            next = next / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+        if (next == done) // not even one block went through
+            return false;
+        done = next;
+    }
+    return true;
+}
+
+/**
+ * @brief Reaps io_uring completions; waits for at least `min_complete` of them
+ * @return false if the ring itself failed, so in-flight buffers can no longer be reaped
+ */
+inline bool io_uring_reap(DirectWriter &writer, unsigned min_complete) {
+    IoUring &ring = writer.ring;
+    unsigned reaped = 0;
+    while (true) {
+        unsigned head = *ring.cq_head;
+        const unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = ring.cqes[head & *ring.cq_mask];
+            DirectBuffer &buffer = writer.buffers[cqe.user_data];
+            if (cqe.res < 0 || !direct_finish_short_write(writer, buffer, static_cast<size_t>(cqe.res)))
+                writer.failed.store(true, std::memory_order_relaxed);
+            buffer.state = BUFFER_FREE;
+            reaped += 1;
+        }
+        __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+        if (reaped >= min_complete)
+            return true;
+
+        long r = syscall(__NR_io_uring_enter, ring.fd, 0u, min_complete - reaped, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (r < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            writer.failed.store(true, std::memory_order_relaxed);
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Submits every queued SQE to the kernel
+ *
+ * The kernel may take fewer than asked for or refuse with EAGAIN/EBUSY while
+ * its completion queue is backed up; completions are reaped and the rest is
+ * submitted again. Queued SQEs are never abandoned, because a later
+ * io_uring_enter would still submit them and write from a reused buffer.
+ *
+ * @return false if io_uring_enter failed for good; the SQEs stay queued and their buffers in flight
+ */
+inline bool io_uring_flush(DirectWriter &writer) {
+    IoUring &ring = writer.ring;
+    while (true) {
+        const unsigned pending = *ring.sq_tail - __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+        if (pending == 0)
+            return true;
+        long r = syscall(__NR_io_uring_enter, ring.fd, pending, 0u, 0u, nullptr, 0);
+        if (r > 0 || (r < 0 && errno == EINTR))
+            continue;
+        if (r < 0 && errno != EAGAIN && errno != EBUSY) {
+            writer.failed.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        io_uring_reap(writer, 0);
+        std::this_thread::yield();
+    }
+}
+
+/**
+ * @brief Thread-pool backend worker: pwrites queued buffers
+ */
+inline void direct_pool_worker(DirectWriter &writer) {
+    std::unique_lock<std::mutex> guard(writer.lock);
+    while (true) {
+        writer.wake.wait(guard, [&] { return writer.stop || !writer.jobs.empty(); });
+        if (writer.jobs.empty())
+            return;
+        const size_t index = writer.jobs.front();
+        writer.jobs.pop_front();
+        guard.unlock();
+
+        bool ok = direct_finish_short_write(writer, writer.buffers[index], 0);
+
+        guard.lock();
+        if (!ok)
+            writer.failed.store(true, std::memory_order_relaxed);
+        writer.buffers[index].state = BUFFER_FREE;
+        writer.wake.notify_all();
+    }
+}
+
+/**
+ * @brief Sends a filled buffer off to be written
+ *
+ * With io_uring the buffer is written synchronously only if it could not be
+ * queued at all; once queued it stays in flight until its completion is reaped.
+ */
+inline void direct_submit(DirectWriter &writer, size_t index) {
+    DirectBuffer &buffer = writer.buffers[index];
+    if (writer.backend == DIRECT_BACKEND_IO_URING) {
+        buffer.state = BUFFER_IN_FLIGHT;
+        if (!io_uring_queue_write(writer.ring, writer.fd, buffer.data, buffer.len, buffer.offset, index)) {
+            if (!direct_finish_short_write(writer, buffer, 0))
+                writer.failed.store(true, std::memory_order_relaxed);
+            buffer.state = BUFFER_FREE;
+            return;
+        }
+        io_uring_flush(writer);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(writer.lock);
+    buffer.state = BUFFER_IN_FLIGHT;
+    writer.jobs.push_back(index);
+    writer.wake.notify_all();
+}
+
+/**
+ * @brief Blocks until buffer `index` is no longer in flight
+ *
+ * A failed write does not stop the wait: the kernel may still be reading
+ * from the buffer. Only a ring that can no longer be submitted to or reaped
+ * does, and the buffer then stays marked in flight.
+ */
+inline void direct_wait_buffer(DirectWriter &writer, size_t index) {
+    if (writer.backend == DIRECT_BACKEND_IO_URING) {
+        while (writer.buffers[index].state == BUFFER_IN_FLIGHT) {
+            if (!io_uring_flush(writer) || !io_uring_reap(writer, 1))
+                return;
+        }
+        return;
+    }
+    std::unique_lock<std::mutex> guard(writer.lock);
+    writer.wake.wait(guard, [&] { return writer.buffers[index].state != BUFFER_IN_FLIGHT; });
+}
+
+/**
+ * @brief Frees the buffers, except any the kernel may still be writing from
+ */
+inline void direct_release_buffers(DirectWriter &writer) {
+    for (auto &buffer : writer.buffers) {
+        // Leaked on purpose: only left in flight when the io_uring broke
+        if (buffer.state != BUFFER_IN_FLIGHT)
+            free(buffer.data);
+    }
+    writer.buffers.clear();
+}
+
+/**
+ * @brief Creates (truncates) a file for asynchronous direct appends
+ * @param writer The writer to open
+ * @param path Path of the file
+ * @param buffer_bytes Size of each buffer, rounded up to DIRECT_ALIGNMENT
+ * @param depth Number of buffers, i.e. at most depth - 1 writes in flight while one fills
+ * @param allow_io_uring Set to false to force the pwrite thread pool
+ * @return true if the file was created and the buffers allocated
+ */
+inline bool direct_writer_open(DirectWriter &writer, const char *path, size_t buffer_bytes = 1 << 20,
+                               size_t depth = 4, bool allow_io_uring = true) {
+    writer.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_DIRECT, 0644);
+    writer.direct = writer.fd >= 0;
+    if (writer.fd < 0 && errno == EINVAL)
+        writer.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer.fd < 0)
+        return false;
+
+    writer.buffer_bytes = (buffer_bytes + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+    writer.buffers.assign(depth < 2 ? 2 : depth, DirectBuffer{});
+    for (auto &buffer : writer.buffers) {
+        void *data = nullptr;
+        if (posix_memalign(&data, DIRECT_ALIGNMENT, writer.buffer_bytes) != 0) {
+            direct_release_buffers(writer);
+            close(writer.fd);
+            writer.fd = -1;
+            return false;
+        }
+        buffer.data = static_cast<uint8_t *>(data);
+    }
+    writer.current = 0;
+    writer.buffers[0].state = BUFFER_FILLING;
+    writer.size = 0;
+    writer.failed.store(false, std::memory_order_relaxed);
+
+    if (allow_io_uring && io_uring_init(writer.ring, static_cast<unsigned>(writer.buffers.size())) &&
+        io_uring_supports_write(writer.ring)) {
+        writer.backend = DIRECT_BACKEND_IO_URING;
+    } else {
+        io_uring_exit(writer.ring);
+        writer.backend = DIRECT_BACKEND_THREAD_POOL;
+        writer.stop = false;
+        for (size_t i = 0; i + 1 < writer.buffers.size(); ++i)
+            writer.pool.emplace_back(direct_pool_worker, std::ref(writer));
+    }
+    return true;
+}
+
+/**
+ * @brief Appends bytes to the file
+ *
+ * Only blocks when every buffer is in flight.
+ *
+ * @param writer The writer to append to
+ * @param data The bytes to append
+ * @param len Number of bytes
+ * @return false once any write has failed
+ */
+inline bool direct_writer_append(DirectWriter &writer, const void *data, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (len > 0 && !writer.failed.load(std::memory_order_relaxed)) {
+        DirectBuffer &buffer = writer.buffers[writer.current];
+        const size_t fill = static_cast<size_t>(writer.size - buffer.offset);
+        const size_t n = len < writer.buffer_bytes - fill ? len : writer.buffer_bytes - fill;
+        memcpy(buffer.data + fill, p, n);
+        p += n;
+        len -= n;
+        writer.size += n;
+
+        if (fill + n == writer.buffer_bytes) {
+            buffer.len = writer.buffer_bytes;
+            direct_submit(writer, writer.current);
+
+            writer.current = (writer.current + 1) % writer.buffers.size();
+            direct_wait_buffer(writer, writer.current);
+            writer.buffers[writer.current].state = BUFFER_FILLING;
+            writer.buffers[writer.current].offset = writer.size;
+        }
+        if (writer.backend == DIRECT_BACKEND_IO_URING)
+            io_uring_reap(writer, 0);
+    }
+    return !writer.failed.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Number of leading bytes of the file that are known to be written
+ *
+ * Everything before the oldest buffer that is still filling or in flight.
+ */
+inline uint64_t direct_writer_committed(DirectWriter &writer) {
+    if (writer.backend == DIRECT_BACKEND_IO_URING)
+        io_uring_reap(writer, 0);
+
+    std::lock_guard<std::mutex> guard(writer.lock);
+    uint64_t committed = writer.size;
+    for (const auto &buffer : writer.buffers) {
+        if (buffer.state != BUFFER_FREE && buffer.offset < committed)
+            committed = buffer.offset;
+    }
+    return committed;
+}
+
+/**
+ * @brief Writes the final partial buffer, waits for all writes and closes the file
+ *
+ * O_DIRECT writes must be whole blocks, so the last buffer is padded with
+ * zeros and the file is truncated back to its logical size afterwards.
+ *
+ * @param writer The writer to close
+ * @return true if every write succeeded
+ */
+inline bool direct_writer_close(DirectWriter &writer) {
+    if (writer.fd < 0)
+        return false;
+
+    DirectBuffer &last = writer.buffers[writer.current];
+    const size_t fill = static_cast<size_t>(writer.size - last.offset);
+    if (fill > 0 && !writer.failed.load(std::memory_order_relaxed)) {
+        last.len = (fill + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+        memset(last.data + fill, 0, last.len - fill);
+        direct_submit(writer, writer.current);
+    } else {
+        last.state = BUFFER_FREE;
+    }
+    for (size_t i = 0; i < writer.buffers.size(); ++i)
+        direct_wait_buffer(writer, i);
+
+    if (writer.backend == DIRECT_BACKEND_IO_URING) {
+        io_uring_exit(writer.ring);
+    } else {
+        {
+            std::lock_guard<std::mutex> guard(writer.lock);
+            writer.stop = true;
+            writer.wake.notify_all();
+        }
+        for (auto &thread : writer.pool)
+            thread.join();
+        writer.pool.clear();
+    }
+
+    bool ok = !writer.failed.load(std::memory_order_relaxed) &&
+              ftruncate(writer.fd, static_cast<off_t>(writer.size)) == 0;
+    close(writer.fd);
+    writer.fd = -1;
+    direct_release_buffers(writer);
+    return ok;
+}
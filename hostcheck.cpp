@@ -0,0 +1,406 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency_histogram.h"
+#include "rt_thread.h"
+
+/*
+ * spsc_hostcheck: inspects how well this host is set up for the RT thread.
+ *
+ * Looks at the kernel command line (isolcpus, nohz_full, rcu_nocbs), the
+ * preemption model, device interrupts routed to the RT CPU, its frequency
+ * governor and SMT siblings, RT throttling and /dev/cpu_dma_latency. With
+ * --measure it also runs the periodic timer on the RT CPU for a moment. Every
+ * finding is PASS, WARN or FAIL with a hint, and the host gets an overall
+ * rating for running the duplex at the given period (2 ms by default).
+ *
+ * --hold-dma-latency keeps /dev/cpu_dma_latency open with the requested
+ * value until the tool is interrupted, which is how the kernel expects a
+ * process to keep deep C-states off.
+ */
+
+enum Verdict { PASS = 0, WARN = 1, FAIL = 2 };
+
+// SCHED_FIFO priority of the --measure thread unless --priority says otherwise
+constexpr int MEASURE_PRIORITY = 80;
+
+struct Report {
+    int warnings = 0;
+    int failures = 0;
+};
+
+static void finding(Report &report, Verdict verdict, const std::string &what, const std::string &hint = "") {
+    static const char *labels[] = {"PASS", "WARN", "FAIL"};
+    printf("[%s] %s\n", labels[verdict], what.c_str());
+    if (verdict != PASS && !hint.empty())
+        printf("       fix: %s\n", hint.c_str());
+    report.warnings += verdict == WARN;
+    report.failures += verdict == FAIL;
+}
+
+/**
+ * @brief Whole contents of a (small) file without the trailing newline, or "" if unreadable
+ */
+static std::string read_text(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return "";
+    std::string text;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, n);
+    fclose(file);
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' '))
+        text.pop_back();
+    return text;
+}
+
+/**
+ * @brief Parses a kernel CPU list such as "2-3,6"; flags like "domain," are skipped
+ */
+static std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+            end = list.size();
+        const std::string item = list.substr(pos, end - pos);
+        int lo, hi;
+        if (sscanf(item.c_str(), "%d-%d", &lo, &hi) == 2) {
+            for (int c = lo; c <= hi; ++c)
+                cpus.push_back(c);
+        } else if (sscanf(item.c_str(), "%d", &lo) == 1) {
+            cpus.push_back(lo);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+static bool contains(const std::vector<int> &cpus, int cpu) {
+    for (int c : cpus) {
+        if (c == cpu)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Value of a `key=` parameter on the kernel command line, or "" if absent
+ */
+static std::string cmdline_value(const std::string &cmdline, const char *key) {
+    const std::string needle = std::string(key) + "=";
+    size_t pos = 0;
+    while ((pos = cmdline.find(needle, pos)) != std::string::npos) {
+        if (pos == 0 || cmdline[pos - 1] == ' ') {
+            const size_t start = pos + needle.size();
+            const size_t end = cmdline.find(' ', start);
+            return cmdline.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        }
+        pos += needle.size();
+    }
+    return "";
+}
+
+static void check_isolation(Report &report, const std::string &cmdline, int cpu) {
+    const std::vector<int> isolated = parse_cpu_list(cmdline_value(cmdline, "isolcpus"));
+    if (contains(isolated, cpu))
+        finding(report, PASS, "CPU " + std::to_string(cpu) + " is in isolcpus");
+    else
+        finding(report, WARN, "CPU " + std::to_string(cpu) + " is not isolated; other tasks may be scheduled on it",
+                "boot with isolcpus=" + std::to_string(cpu) + " (or use cpusets)");
+
+    const std::vector<int> nohz = parse_cpu_list(cmdline_value(cmdline, "nohz_full"));
+    if (contains(nohz, cpu))
+        finding(report, PASS, "CPU " + std::to_string(cpu) + " is in nohz_full");
+    else
+        finding(report, WARN, "CPU " + std::to_string(cpu) + " still takes the periodic scheduler tick",
+                "boot with nohz_full=" + std::to_string(cpu));
+
+    const std::vector<int> rcu = parse_cpu_list(cmdline_value(cmdline, "rcu_nocbs"));
+    if (contains(rcu, cpu))
+        finding(report, PASS, "RCU callbacks are offloaded from CPU " + std::to_string(cpu));
+    else
+        finding(report, WARN, "RCU callbacks may run on CPU " + std::to_string(cpu),
+                "boot with rcu_nocbs=" + std::to_string(cpu));
+}
+
+static void check_preemption(Report &report) {
+    struct utsname name;
+    const std::string version = uname(&name) == 0 ? name.version : "";
+    if (read_text("/sys/kernel/realtime") == "1" || version.find("PREEMPT_RT") != std::string::npos)
+        finding(report, PASS, "kernel is PREEMPT_RT");
+    else if (version.find("PREEMPT") != std::string::npos)
+        finding(report, WARN, "kernel is preemptible but not PREEMPT_RT (" + version + ")",
+                "a PREEMPT_RT kernel bounds worst-case latency much tighter");
+    else
+        finding(report, FAIL, "kernel is not preemptible (" + version + ")", "use a PREEMPT or PREEMPT_RT kernel");
+}
+
+/**
+ * @brief Name of the first handler registered on an IRQ (its subdirectory in /proc/irq/N), or "" if none
+ */
+static std::string irq_handler(const std::string &dir) {
+    DIR *entries = opendir(dir.c_str());
+    if (entries == nullptr)
+        return "";
+    std::string name;
+    while (struct dirent *entry = readdir(entries)) {
+        if (entry->d_type == DT_DIR && entry->d_name[0] != '.') {
+            name = entry->d_name;
+            break;
+        }
+    }
+    closedir(entries);
+    return name;
+}
+
+/**
+ * @brief Lists the device IRQs that may be delivered to `cpu`, from /proc/irq/N
+ *
+ * Uses the affinity the kernel actually programmed (effective_affinity_list)
+ * where it exists and the requested one (smp_affinity_list) otherwise. IRQs
+ * without a handler are skipped since they cannot fire.
+ */
+static void check_interrupts(Report &report, int cpu) {
+    DIR *irqs = opendir("/proc/irq");
+    if (irqs == nullptr) {
+        finding(report, WARN, "cannot read /proc/irq");
+        return;
+    }
+
+    std::string routed;
+    int device_irqs = 0;
+    int readable = 0;
+    while (struct dirent *entry = readdir(irqs)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9')
+            continue;
+        const std::string dir = std::string("/proc/irq/") + entry->d_name;
+        std::string affinity = read_text(dir + "/effective_affinity_list");
+        if (affinity.empty())
+            affinity = read_text(dir + "/smp_affinity_list");
+        if (affinity.empty())
+            continue;
+        readable += 1;
+        const std::string handler = irq_handler(dir);
+        if (handler.empty() || !contains(parse_cpu_list(affinity), cpu))
+            continue;
+        device_irqs += 1;
+        if (routed.size() < 60)
+            routed += (routed.empty() ? "" : " ") + std::string(entry->d_name) + ":" + handler;
+    }
+    closedir(irqs);
+
+    if (readable == 0)
+        finding(report, WARN, "no IRQ affinities readable under /proc/irq");
+    else if (device_irqs == 0)
+        finding(report, PASS, "no device IRQs are routed to CPU " + std::to_string(cpu));
+    else
+        finding(report, WARN, std::to_string(device_irqs) + " device IRQs are routed to CPU " + std::to_string(cpu)
+                + " (" + routed + ")", "steer them away via /proc/irq/N/smp_affinity_list or irqbalance --banirq");
+}
+
+static void check_cpu(Report &report, int cpu) {
+    const std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+
+    const std::string governor = read_text(base + "/cpufreq/scaling_governor");
+    if (governor.empty())
+        finding(report, PASS, "no cpufreq governor exposed (fixed frequency or virtualized)");
+    else if (governor == "performance")
+        finding(report, PASS, "frequency governor is performance");
+    else
+        finding(report, WARN, "frequency governor is " + governor + "; frequency changes add latency",
+                "echo performance > " + base + "/cpufreq/scaling_governor");
+
+    const std::vector<int> siblings = parse_cpu_list(read_text(base + "/topology/thread_siblings_list"));
+    if (siblings.size() <= 1) {
+        finding(report, PASS, "CPU " + std::to_string(cpu) + " has no SMT sibling");
+    } else {
+        std::string others;
+        for (int s : siblings) {
+            if (s != cpu)
+                others += (others.empty() ? "" : ",") + std::to_string(s);
+        }
+        finding(report, WARN, "CPU " + std::to_string(cpu) + " shares its core with CPU " + others,
+                "isolate the sibling too, or disable SMT (echo off > /sys/devices/system/cpu/smt/control)");
+    }
+}
+
+static void check_throttling(Report &report) {
+    const std::string runtime = read_text("/proc/sys/kernel/sched_rt_runtime_us");
+    const std::string rt_period = read_text("/proc/sys/kernel/sched_rt_period_us");
+    if (runtime.empty()) {
+        finding(report, WARN, "cannot read sched_rt_runtime_us");
+    } else if (runtime == "-1") {
+        finding(report, PASS, "RT throttling is disabled");
+    } else {
+        finding(report, WARN, "RT tasks are throttled to " + runtime + " us per " + rt_period
+                + " us; a runaway RT loop is stopped, but so is a legitimately busy one",
+                "echo -1 > /proc/sys/kernel/sched_rt_runtime_us (only with a watchdog in place)");
+    }
+}
+
+static void check_dma_latency(Report &report) {
+    if (access("/dev/cpu_dma_latency", F_OK) != 0)
+        finding(report, WARN, "/dev/cpu_dma_latency does not exist; C-state exit latency cannot be capped");
+    else if (access("/dev/cpu_dma_latency", W_OK) != 0)
+        finding(report, WARN, "/dev/cpu_dma_latency is not writable by this user",
+                "run the RT process with enough privileges to hold it open");
+    else
+        finding(report, PASS, "/dev/cpu_dma_latency is available (use --hold-dma-latency to apply it)");
+}
+
+/**
+ * @brief Runs the periodic timer on the RT CPU and rates its worst wake-ups against the period
+ */
+static void check_wakeups(Report &report, const RtThreadConfig &rt, int64_t period_ns, double seconds) {
+    static LatencyHistogram<> histogram;
+    bool fifo = false;
+    std::thread t = rt_thread_launch(rt, [&]() {
+        // rt_thread_launch() carries on without SCHED_FIFO if it is refused, so look at what was granted
+        int policy;
+        sched_param param;
+        fifo = pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy == SCHED_FIFO;
+
+        PeriodicTimer timer;
+        timer_start(timer, period_ns, TimerMode::ClockNanosleep);
+        const int64_t cycles = static_cast<int64_t>(seconds * 1e9) / period_ns;
+        for (int64_t i = 0; i < cycles; ++i)
+            histogram_add(histogram, timer_wait(timer));
+    });
+    t.join();
+    histogram_print_summary(histogram, "       wake-up");
+
+    const double worst_us = histogram_percentile_us(histogram, 0.999);
+    const double period_us = period_ns / 1000.0;
+    const std::string what = "p99.9 wake-up latency " + std::to_string(static_cast<int>(worst_us)) + " us at a "
+                           + std::to_string(static_cast<int>(period_us)) + " us period";
+    const std::string how = fifo ? "" : " (measured without RT priority, at SCHED_OTHER)";
+    if (worst_us < 0.1 * period_us)
+        finding(report, PASS, what + how);
+    else if (worst_us < 0.5 * period_us)
+        finding(report, WARN, what + " eats into the cycle budget" + how);
+    else
+        finding(report, FAIL, what + " leaves no room for the cycle's work" + how);
+    if (!fifo)
+        finding(report, WARN, "the measurement does not show what an RT thread would see",
+                "run as root or with CAP_SYS_NICE and --priority 1..99");
+}
+
+/**
+ * @brief Whether a CPU is online, per /sys/devices/system/cpu/online
+ */
+static bool cpu_online(int cpu) {
+    const std::string online = read_text("/sys/devices/system/cpu/online");
+    if (online.empty())
+        return cpu >= 0 && cpu < static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+    return contains(parse_cpu_list(online), cpu);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: spsc_hostcheck [--cpu N] [--period-us N] [--measure SECONDS] [--priority P]\n"
+            "                      [--hold-dma-latency US]\n"
+            "  --cpu defaults to the last isolated CPU, or the last online CPU.\n"
+            "  --measure runs at SCHED_FIFO priority %d unless --priority says otherwise (0: SCHED_OTHER).\n",
+            MEASURE_PRIORITY);
+}
+
+/**
+ * @brief Entry point of the host checker
+ */
+int main(int argc, char **argv) {
+    int cpu = -1;
+    int64_t period_ns = 2000000;
+    double measure_seconds = 0.0;
+    int priority = MEASURE_PRIORITY;
+    int hold_dma_us = -1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--cpu") == 0 && i + 1 < argc) {
+            cpu = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--period-us") == 0 && i + 1 < argc) {
+            period_ns = atoll(argv[++i]) * 1000;
+        } else if (strcmp(argv[i], "--measure") == 0 && i + 1 < argc) {
+            measure_seconds = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--priority") == 0 && i + 1 < argc) {
+            priority = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--hold-dma-latency") == 0 && i + 1 < argc) {
+            hold_dma_us = atoi(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (period_ns <= 0) {
+        usage();
+        return 2;
+    }
+
+    const std::string cmdline = read_text("/proc/cmdline");
+    if (cpu < 0) {
+        const std::vector<int> isolated = parse_cpu_list(cmdline_value(cmdline, "isolcpus"));
+        const std::vector<int> online = parse_cpu_list(read_text("/sys/devices/system/cpu/online"));
+        cpu = !isolated.empty() ? isolated.back()
+            : !online.empty()   ? online.back()
+                                : static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)) - 1;
+    }
+    if (!cpu_online(cpu)) {
+        fprintf(stderr, "CPU %d is not online\n", cpu);
+        return 2;
+    }
+
+    printf("RT readiness of this host for CPU %d at a %.0f us period\n\n", cpu, period_ns / 1000.0);
+    Report report;
+    check_preemption(report);
+    check_isolation(report, cmdline, cpu);
+    check_interrupts(report, cpu);
+    check_cpu(report, cpu);
+    check_throttling(report);
+    check_dma_latency(report);
+    if (measure_seconds > 0) {
+        RtThreadConfig rt;
+        rt.cpu = cpu;
+        rt.priority = priority;
+        check_wakeups(report, rt, period_ns, measure_seconds);
+    }
+
+    const char *rating = report.failures > 0 ? "NOT READY" : report.warnings > 2 ? "MARGINAL" : "READY";
+    printf("\nrating: %s (%d warnings, %d failures)\n", rating, report.warnings, report.failures);
+
+    if (hold_dma_us >= 0) {
+        // The request only lasts while the file stays open
+        int fd = open("/dev/cpu_dma_latency", O_WRONLY | O_CLOEXEC);
+        int32_t value = hold_dma_us;
+        if (fd < 0 || write(fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value))) {
+            perror("/dev/cpu_dma_latency");
+            if (fd >= 0)
+                close(fd);
+            return 1;
+        }
+        printf("holding /dev/cpu_dma_latency at %d us until interrupted\n", hold_dma_us);
+        fflush(stdout);
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, SIGINT);
+        sigaddset(&set, SIGTERM);
+        sigprocmask(SIG_BLOCK, &set, nullptr);
+        int sig;
+        sigwait(&set, &sig);
+        close(fd);
+    }
+    return report.failures > 0 ? 1 : 0;
+}
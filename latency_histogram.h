@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief A cyclictest-style latency histogram with 1 us buckets.
+ *
+ * Latencies of `Buckets` microseconds or more land in the overflow count but
+ * still update `max`, so the worst case is never hidden.
+ */
+template <size_t Buckets = 10000>
+struct LatencyHistogram {
+    uint64_t buckets[Buckets] = {};
+    uint64_t overflow = 0;
+    uint64_t count = 0;
+    int64_t min_ns = INT64_MAX;
+    int64_t max_ns = INT64_MIN;
+    double sum_ns = 0.0;
+};
+
+/**
+ * @brief Records one latency
+ * @param histogram The histogram to update
+ * @param latency_ns The latency in nanoseconds; negative values count as 0
+ */
+template <size_t Buckets>
+void histogram_add(LatencyHistogram<Buckets> &histogram, int64_t latency_ns) {
+    const int64_t clamped = latency_ns < 0 ? 0 : latency_ns;
+    const uint64_t us = static_cast<uint64_t>(clamped / 1000);
+    if (us < Buckets)
+        histogram.buckets[us] += 1;
+    else
+        histogram.overflow += 1;
+    histogram.count += 1;
+    histogram.min_ns = latency_ns < histogram.min_ns ? latency_ns : histogram.min_ns;
+    histogram.max_ns = latency_ns > histogram.max_ns ? latency_ns : histogram.max_ns;
+    histogram.sum_ns += static_cast<double>(latency_ns);
+}
+
+/**
+ * @brief Latency in microseconds below which a fraction `q` of the samples fall
+ *
+ * Resolution is one bucket (1 us); a quantile in the overflow reports the max.
+ */
+template <size_t Buckets>
+double histogram_percentile_us(const LatencyHistogram<Buckets> &histogram, double q) {
+    if (histogram.count == 0)
+        return 0.0;
+    const double target = q * static_cast<double>(histogram.count);
+    uint64_t seen = 0;
+    for (size_t b = 0; b < Buckets; ++b) {
+        seen += histogram.buckets[b];
+        if (static_cast<double>(seen) >= target && histogram.buckets[b] > 0)
+            return static_cast<double>(b + 1);
+    }
+    return static_cast<double>(histogram.max_ns) / 1000.0;
+}
+
+/**
+ * @brief Prints min/avg/max and percentiles on one line
+ */
+template <size_t Buckets>
+void histogram_print_summary(const LatencyHistogram<Buckets> &histogram, const char *label) {
+    if (histogram.count == 0) {
+        printf("%-14s no samples\n", label);
+        return;
+    }
+    printf("%-14s n=%-8llu min %8.1f  avg %8.1f  p50 %6.0f  p99 %6.0f  p99.9 %6.0f  max %8.1f us\n", label,
+           static_cast<unsigned long long>(histogram.count), histogram.min_ns / 1000.0,
+           histogram.sum_ns / static_cast<double>(histogram.count) / 1000.0,
+           histogram_percentile_us(histogram, 0.50), histogram_percentile_us(histogram, 0.99),
+           histogram_percentile_us(histogram, 0.999), histogram.max_ns / 1000.0);
+}
+
+/**
+ * @brief Prints the non-empty buckets, one "<us> <count>" line each, as cyclictest -h does
+ */
+template <size_t Buckets>
+void histogram_print_buckets(const LatencyHistogram<Buckets> &histogram) {
+    for (size_t b = 0; b < Buckets; ++b) {
+        if (histogram.buckets[b] > 0)
+            printf("%06zu %llu\n", b, static_cast<unsigned long long>(histogram.buckets[b]));
+    }
+    if (histogram.overflow > 0)
+        printf("overflow %llu\n", static_cast<unsigned long long>(histogram.overflow));
+}
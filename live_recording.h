@@ -0,0 +1,163 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+
+#include "spsc.h"
+
+/**
+ * @brief Shared-memory header through which a recorder announces its progress.
+ *
+ * The recorder publishes the path of the file it is writing, the file layout,
+ * how many bytes of it are complete and how many chunks that covers. Any
+ * number of local viewer processes can attach read-only and follow the
+ * recording by mapping the file up to `committed_offset`, without another
+ * channel hop from the RT process.
+ *
+ * `path` and the layout fields are guarded by `generation` like a seqlock:
+ * it is odd while they are being rewritten (segment rotation) and is bumped
+ * to the next even value afterwards. `previous_offset` keeps the final
+ * committed size of the file that was replaced, so a viewer can finish it.
+ */
+struct LiveHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    std::atomic<uint64_t> generation{0};
+    char path[256];
+    uint32_t axes;
+    uint32_t value_type;
+    uint32_t record_size;
+    uint64_t previous_offset;
+
+    alignas(64) std::atomic<uint64_t> committed_offset{0};
+    std::atomic<uint64_t> chunk_count{0};
+    std::atomic<uint32_t> closed{0};
+};
+
+constexpr uint32_t LIVE_MAGIC = 0x4556494c; // "LIVE"
+constexpr uint32_t LIVE_VERSION = 1;
+
+/**
+ * @brief Creates (or replaces) the shared-memory header `/name` for a recorder to publish into
+ * @param name POSIX shm name, starting with '/'
+ * @return The header, or nullptr on failure
+ */
+inline LiveHeader *live_create(const char *name) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return nullptr;
+    if (ftruncate(fd, sizeof(LiveHeader)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    void *map = mmap(nullptr, sizeof(LiveHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return nullptr;
+
+    LiveHeader *live = channel_create_at<LiveHeader>(map, sizeof(LiveHeader));
+    live->magic = LIVE_MAGIC;
+    live->version = LIVE_VERSION;
+    return live;
+}
+
+/**
+ * @brief Attaches read-only to a header created by live_create()
+ * @param name POSIX shm name, starting with '/'
+ * @return The header, or nullptr if it does not exist or is not a LiveHeader
+ */
+inline const LiveHeader *live_attach(const char *name) {
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return nullptr;
+    void *map = mmap(nullptr, sizeof(LiveHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return nullptr;
+
+    const LiveHeader *live = channel_attach<LiveHeader>(map, sizeof(LiveHeader));
+    if (live == nullptr || live->magic != LIVE_MAGIC || live->version != LIVE_VERSION) {
+        munmap(map, sizeof(LiveHeader));
+        return nullptr;
+    }
+    return live;
+}
+
+/**
+ * @brief Unmaps a header; with `name` given, also removes the shm object
+ */
+inline void live_close(const LiveHeader *live, const char *name = nullptr) {
+    munmap(const_cast<LiveHeader *>(live), sizeof(LiveHeader));
+    if (name != nullptr)
+        shm_unlink(name);
+}
+
+/**
+ * @brief Announces the file the recorder has started writing (called by the recorder)
+ */
+inline void live_publish_file(LiveHeader &live, const char *path, uint32_t axes, uint32_t value_type,
+                              uint32_t record_size, uint64_t committed_offset) {
+    const uint64_t g = live.generation.load(std::memory_order_relaxed);
+    live.generation.store(g + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    strncpy(live.path, path, sizeof(live.path) - 1);
+    live.path[sizeof(live.path) - 1] = '\0';
+    live.axes = axes;
+    live.value_type = value_type;
+    live.record_size = record_size;
+    live.previous_offset = live.committed_offset.load(std::memory_order_relaxed);
+    live.chunk_count.store(0, std::memory_order_relaxed);
+    live.committed_offset.store(committed_offset, std::memory_order_relaxed);
+
+    live.generation.store(g + 2, std::memory_order_release);
+}
+
+/**
+ * @brief Publishes how much of the current file is complete (called by the recorder)
+ */
+inline void live_publish_progress(LiveHeader &live, uint64_t committed_offset, uint64_t chunk_count) {
+    live.chunk_count.store(chunk_count, std::memory_order_relaxed);
+    live.committed_offset.store(committed_offset, std::memory_order_release);
+}
+
+/**
+ * @brief A consistent copy of the file description in a LiveHeader.
+ */
+struct LiveFile {
+    uint64_t generation;
+    char path[256];
+    uint32_t axes;
+    uint32_t value_type;
+    uint32_t record_size;
+    uint64_t previous_offset;
+};
+
+/**
+ * @brief Reads the file description, retrying while the recorder is rewriting it
+ */
+inline LiveFile live_read_file(const LiveHeader &live) {
+    LiveFile file;
+    while (true) {
+        const uint64_t before = live.generation.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        memcpy(file.path, live.path, sizeof(file.path));
+        file.axes = live.axes;
+        file.value_type = live.value_type;
+        file.record_size = live.record_size;
+        file.previous_offset = live.previous_offset;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (live.generation.load(std::memory_order_relaxed) == before) {
+            file.generation = before;
+            file.path[sizeof(file.path) - 1] = '\0';
+            return file;
+        }
+    }
+}
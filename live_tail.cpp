@@ -0,0 +1,183 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <chrono>
+#include <thread>
+
+#include "live_recording.h"
+#include "recording_reader.h"
+
+/*
+ * spsc_tail: follows a recording while it is being written.
+ *
+ * The recorder publishes the file it writes and its committed size in a
+ * shared-memory LiveHeader. This tool maps that file read-only, walks the
+ * chunks between the last position and the committed offset in place and
+ * prints their records. When the recorder moves on to a new segment the rest
+ * of the old one is printed before switching.
+ */
+
+/**
+ * @brief A recording file mapped read-only up to some length.
+ */
+struct TailFile {
+    int fd = -1;
+    const uint8_t *map = nullptr;
+    uint64_t map_len = 0;
+    uint64_t offset = 0; // of the next chunk to print
+    uint32_t axes = 0;
+    uint32_t value_type = VALUE_F32;
+    uint32_t record_size = 0;
+};
+
+static void tail_close(TailFile &file) {
+    if (file.map != nullptr)
+        munmap(const_cast<uint8_t *>(file.map), file.map_len);
+    if (file.fd >= 0)
+        close(file.fd);
+    file = TailFile();
+}
+
+/**
+ * @brief Makes at least `len` bytes of the file visible through `file.map`
+ */
+static bool tail_map(TailFile &file, uint64_t len) {
+    if (len <= file.map_len)
+        return true;
+    if (file.map != nullptr)
+        munmap(const_cast<uint8_t *>(file.map), file.map_len);
+    void *map = mmap(nullptr, len, PROT_READ, MAP_SHARED, file.fd, 0);
+    if (map == MAP_FAILED) {
+        file.map = nullptr;
+        file.map_len = 0;
+        return false;
+    }
+    file.map = static_cast<const uint8_t *>(map);
+    file.map_len = len;
+    return true;
+}
+
+/**
+ * @brief Opens the file a LiveHeader currently announces
+ */
+static bool tail_open(TailFile &file, const LiveFile &live) {
+    file.fd = open(live.path, O_RDONLY | O_CLOEXEC);
+    if (file.fd < 0)
+        return false;
+    file.axes = live.axes;
+    file.value_type = live.value_type;
+    file.record_size = live.record_size;
+    file.offset = sizeof(RecordingHeader);
+    // Records are decoded with these, so they must agree before any chunk is read
+    if ((live.value_type != VALUE_F32 && live.value_type != VALUE_F64)
+        || live.record_size != sizeof(RecordPrefix) + live.axes * value_type_size(live.value_type)) {
+        tail_close(file);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Prints every complete chunk between `file.offset` and `end`
+ *
+ * Stops early at anything that is not a complete, plausible chunk, e.g. the
+ * zeroed, preallocated tail of a segment: chunk headers are checked like
+ * index entries, so a corrupt count or size cannot read past `end`.
+ */
+static void tail_print(TailFile &file, uint64_t end) {
+    if (end <= file.offset || !tail_map(file, end))
+        return;
+
+    std::vector<uint8_t> decoded;
+    while (file.offset + sizeof(ChunkHeader) <= end) {
+        ChunkHeader header;
+        memcpy(&header, file.map + file.offset, sizeof(header));
+        const IndexEntry entry = {header.first_time_ns, header.last_time_ns, file.offset,
+                                  header.payload_bytes, header.count, header.magic == CHUNK_XOR_RLE_MAGIC};
+        if ((header.magic != CHUNK_MAGIC && header.magic != CHUNK_XOR_RLE_MAGIC)
+            || !chunk_entry_valid(entry, end, file.record_size))
+            return;
+
+        ChunkView view;
+        view.records = file.map + file.offset + sizeof(header);
+        view.count = header.count;
+        view.record_size = file.record_size;
+        if (header.magic == CHUNK_XOR_RLE_MAGIC) {
+            decoded.resize(static_cast<size_t>(header.count) * file.record_size);
+            if (!chunk_decode(view.records, header.payload_bytes, file.record_size, decoded.data(), decoded.size()))
+                return;
+            view.records = decoded.data();
+        }
+
+        for (size_t r = 0; r < view.count; ++r) {
+            const RecordPrefix prefix = chunk_record_prefix(view, r);
+            const uint8_t *values = chunk_record_values(view, r);
+            printf("%lld.%09lld %llu", static_cast<long long>(prefix.time_ns / 1000000000),
+                   static_cast<long long>(prefix.time_ns % 1000000000), static_cast<unsigned long long>(prefix.cycle));
+            for (uint32_t a = 0; a < file.axes; ++a) {
+                double v;
+                if (file.value_type == VALUE_F64) {
+                    memcpy(&v, values + a * sizeof(double), sizeof(double));
+                } else {
+                    float f;
+                    memcpy(&f, values + a * sizeof(float), sizeof(float));
+                    v = f;
+                }
+                printf(" %g", v);
+            }
+            printf("\n");
+        }
+        file.offset += sizeof(header) + header.payload_bytes;
+    }
+}
+
+/**
+ * @brief Entry point of the tail tool
+ *
+ * Usage: spsc_tail NAME
+ */
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: spsc_tail NAME\n  NAME is the shared-memory name given to spsc_app --live\n");
+        return 2;
+    }
+
+    const LiveHeader *live = live_attach(argv[1]);
+    if (live == nullptr) {
+        fprintf(stderr, "no live recording %s\n", argv[1]);
+        return 1;
+    }
+
+    TailFile file;
+    uint64_t generation = 0;
+    while (true) {
+        const bool closed = live->closed.load(std::memory_order_acquire) != 0;
+        const uint64_t g = live->generation.load(std::memory_order_acquire);
+        if (g != generation && (g & 1) == 0) {
+            // Finish the old file, unless more than one rotation went by unseen
+            const LiveFile next = live_read_file(*live);
+            if (file.fd >= 0 && next.generation == generation + 2)
+                tail_print(file, next.previous_offset);
+            tail_close(file);
+            generation = next.generation;
+            if (!tail_open(file, next))
+                fprintf(stderr, "cannot open %s\n", next.path);
+        }
+
+        // The offset only belongs to this file if no rotation happened while reading it
+        const uint64_t committed = live->committed_offset.load(std::memory_order_acquire);
+        if (file.fd >= 0 && live->generation.load(std::memory_order_acquire) == generation)
+            tail_print(file, committed);
+        fflush(stdout);
+
+        if (closed && live->generation.load(std::memory_order_acquire) == generation)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    tail_close(file);
+    live_close(live);
+    return 0;
+}
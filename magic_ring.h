@@ -0,0 +1,188 @@
+#pragma once
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <atomic>
+
+/**
+ * @brief A lock-free SPSC byte ring whose storage is mapped twice in a row.
+ *
+ * The same physical pages (a memfd) are mapped at `base` and again at
+ * `base + capacity`, so any span of up to `capacity` bytes starting anywhere
+ * in the first mapping is contiguous in virtual memory. Variable-length
+ * records and batch reads never have to be split at the wrap point; they can
+ * be parsed in place or handed to writev/SIMD kernels as a single span.
+ *
+ * `head` and `tail` are free-running byte counters, like in Ring.
+ */
+struct MagicRing {
+    alignas(64) std::atomic<size_t> head{0};
+
+    alignas(64) std::atomic<size_t> tail{0};
+
+    alignas(64) uint8_t *base = nullptr;
+    size_t capacity = 0;
+    int fd = -1;
+};
+
+/**
+ * @brief Maps the storage for a MagicRing
+ *
+ * Must be called before the ring is shared with the other thread. The
+ * capacity must be a power of two and a multiple of the page size.
+ *
+ * @param ring The ring to initialize
+ * @param capacity The size of the ring in bytes
+ * @return true if both mappings were created, false otherwise
+ */
+inline bool magic_ring_create(MagicRing &ring, size_t capacity) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || capacity % page != 0)
+        return false;
+
+    int fd = memfd_create("magic_ring", MFD_CLOEXEC);
+    if (fd < 0)
+        return false;
+    if (ftruncate(fd, static_cast<off_t>(capacity)) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Reserve 2x the address space first so the two views land back-to-back
+    void *reserved = mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    uint8_t *base = static_cast<uint8_t *>(reserved);
+    void *lo = mmap(base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    void *hi = mmap(base + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+    if (lo == MAP_FAILED || hi == MAP_FAILED) {
+        munmap(reserved, 2 * capacity);
+        close(fd);
+        return false;
+    }
+
+    ring.base = base;
+    ring.capacity = capacity;
+    ring.fd = fd;
+    ring.head.store(0, std::memory_order_relaxed);
+    ring.tail.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * @brief Unmaps the storage of a MagicRing. Neither thread may use it afterwards
+ * @param ring The ring to tear down
+ */
+inline void magic_ring_destroy(MagicRing &ring) {
+    if (ring.base != nullptr)
+        munmap(ring.base, 2 * ring.capacity);
+    if (ring.fd >= 0)
+        close(ring.fd);
+    ring.base = nullptr;
+    ring.capacity = 0;
+    ring.fd = -1;
+}
+
+/**
+ * @brief Reserves `len` contiguous bytes for the producer to write into
+ *
+ * Nothing becomes visible to the consumer until magic_ring_commit() is
+ * called. Calling reserve again without committing returns the same span.
+ *
+ * @param ring The ring to write into
+ * @param len Number of bytes needed
+ * @return Pointer to the writable span, or nullptr if there is not enough free space
+ */
+inline uint8_t *magic_ring_reserve(MagicRing &ring, size_t len) {
+    size_t h = ring.head.load(std::memory_order_relaxed);
+    size_t t = ring.tail.load(std::memory_order_acquire);
+    if (ring.capacity - (h - t) < len) // not enough room
+        return nullptr;
+
+    return ring.base + (h & (ring.capacity - 1));
+}
+
+/**
+ * @brief Publishes `len` previously reserved bytes to the consumer
+ * @param ring The ring that was written into
+ * @param len Number of bytes to publish
+ */
+inline void magic_ring_commit(MagicRing &ring, size_t len) {
+    size_t h = ring.head.load(std::memory_order_relaxed);
+    ring.head.store(h + len, std::memory_order_release);
+}
+
+/**
+ * @brief Copies a record into the ring and publishes it
+ * @param ring The ring to write into
+ * @param data The bytes to push
+ * @param len Number of bytes to push
+ * @return true if the record was pushed, false if the ring was full
+ */
+inline bool magic_ring_try_push(MagicRing &ring, const void *data, size_t len) {
+    uint8_t *dst = magic_ring_reserve(ring, len);
+    if (dst == nullptr)
+        return false;
+
+    memcpy(dst, data, len);
+    magic_ring_commit(ring, len);
+    return true;
+}
+
+/**
+ * @brief Returns every byte that is currently readable as one contiguous span
+ * @param ring The ring to read from
+ * @param[out] len Number of readable bytes
+ * @return Pointer to the first unread byte (only valid until the next release)
+ */
+inline const uint8_t *magic_ring_readable(MagicRing &ring, size_t &len) {
+    size_t t = ring.tail.load(std::memory_order_relaxed);
+    size_t h = ring.head.load(std::memory_order_acquire);
+    len = h - t;
+    return ring.base + (t & (ring.capacity - 1));
+}
+
+/**
+ * @brief Hands `len` consumed bytes back to the producer
+ * @param ring The ring that was read from
+ * @param len Number of bytes consumed
+ */
+inline void magic_ring_release(MagicRing &ring, size_t len) {
+    size_t t = ring.tail.load(std::memory_order_relaxed);
+    ring.tail.store(t + len, std::memory_order_release);
+}
+
+/**
+ * @brief Writes up to `max` readable bytes straight from ring memory to a file descriptor
+ *
+ * Thanks to the double mapping the readable bytes are always one span, so a
+ * single write() suffices. Only the bytes the kernel accepted are released.
+ *
+ * @param ring The ring to drain
+ * @param fd The file descriptor to write to
+ * @param max Maximum number of bytes to drain
+ * @return Number of bytes drained, or -1 if the write failed (errno is set)
+ */
+inline ssize_t magic_ring_drain_to_fd(MagicRing &ring, int fd, size_t max) {
+    size_t len;
+    const uint8_t *span = magic_ring_readable(ring, len);
+    if (len > max)
+        len = max;
+    if (len == 0)
+        return 0;
+
+    ssize_t written;
+    do {
+        written = write(fd, span, len);
+    } while (written < 0 && errno == EINTR);
+    if (written > 0)
+        magic_ring_release(ring, static_cast<size_t>(written));
+    return written;
+}
@@ -1,188 +1,223 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <thread>
 #include <iostream>
 #include <atomic>
+#include <vector>
+
+#include "spsc.h"
+#include "telemetry.h"
+#include "recorder.h"
+#include "segmented_recorder.h"
+#include "command_log.h"
+#include "rt_logic.h"
+#include "quantile_sketch.h"
+#include "spectrum.h"
+#include "udp_bridge.h"
+#include "rt_thread.h"
+
+using Commands = CommandLog<Message>;
+using Sketches = FieldSketches<Message::axes>;
+using Spectrum = SpectrumAnalyzer<Message::axes, 64>;
 
 /**
- * @brief A generic message structure for communication between threads.
- *
- * This simple "Plain Old Data" (POD) struct is used for both sending commands
- * from the Observer to the RT thread and for sending data back from the RT
- * thread to the Observer
- */
-struct Message {
-    float arrayOfNumbers[8];
-    bool keepRunning;
-};
-
-// This is a compile-time check that ensures the Message struct is "trivially copyable".
-// This is critical for high-performance applications because it guarantees that
-// copying a Message can be done with a simple, fast, bit-for-bit memory copy (like memcpy),
-// without any unexpected side effects from user-defined constructors or destructors.
-static_assert(std::is_trivially_copyable_v<Message>,"Message must be trivial.");
-
-/**
- * @brief A lock-free SPSC queue for the RT -> Observer data channel.
+ * @brief The main function for the high-frequency Real-Time (RT) thread.
  *
- * This struct implements one half of a bidirectional SPSC communication
- * system. It serves as the channel for the RT thread to
- * send a stream of data messages for the Observer thread to read from. The other direction,
- * for sending commands, is handled by the Mailbox.
- */
-struct alignas(64) Ring {
-    std::atomic<size_t> head{0};
-
-    std::atomic<size_t> tail{0};
-
-    Message buf[8];
-};
-
-/**
- * @brief A lock-free SPSC mailbox for the Observer -> RT command channel.
+ * This function runs in a continuous loop at a fixed rate (20ms). In each
+ * cycle, it peeks at the CommandMailbox to get the latest command from the
+ * Observer thread, logging it with the cycle number if it is new. It then
+ * runs one rt_step() with that command, which pushes a new data message onto
+ * the bulk lane of the outgoing telemetry channel and reports command changes
+ * and shutdown as events on the critical lane.
  *
- * This struct implements one half of a bidirectional SPSC communication
- * system. It serves as the "last value matters" channel for the Observer
- * thread to send command updates to the RT thread. The other direction, for
- * sending a stream of data, is handled by the Ring queue.
+ * @param tx The telemetry channel to push outgoing data messages into.
+ * @param mailbox The Mailbox to peek for incoming commands from.
+ * @param commands The log every newly observed command is appended to.
  */
-struct Mailbox {
-    Message slots[2];
-
-    alignas(64) std::atomic<int> latest_idx{0};
-};
+void continuousThreadFunction(Telemetry &tx, Mailbox &mailbox, Commands &commands){
+    RtState state;
+    PeriodicTimer timer;
+    timer_start(timer, RT_PERIOD_NS);
 
-/**
- * @brief Sends a command from the Observer thread to the RT thread
- *
- * This function is called by the low-frequency Observer thread to update the
- * command state for the RT thread. It uses a double-buffer mailbox to ensure
- * the command is sent safely without blocking and without data corruption
- *
- * @param mailbox The Mailbox to send the command to
- * @param command The Message object containing the command data
- */
-void send_command(Mailbox &mailbox, const Message &command) {
-    const int current_idx = mailbox.latest_idx.load(std::memory_order_relaxed);
-    const int write_idx = 1 - current_idx;
+    while(true) {
+        Message command = command_log_peek(commands, mailbox, state.cycle + 1);
 
-    mailbox.slots[write_idx] = command;
+        if (!rt_step(state, command, realtime_now_ns(), tx))
+            break;
 
-    mailbox.latest_idx.store(write_idx, std::memory_order_release);
+        printf("  RT Thread Pushed:  %f\n", state.last_output);
+        timer_wait(timer);
+    }
 }
 
 /**
- * @brief Safely peeks at the latest message in the mailbox
- * @param mailbox The mailbox to peek from
- * @return A copy of the latest, complete message
+ * @brief Where drained samples are recorded: one file, or rotating segments with --rotate-mb
  */
-Message peek(Mailbox &mailbox) {
-    const int read_idx = mailbox.latest_idx.load(std::memory_order_acquire);
-
-    return mailbox.slots[read_idx];
-}
+struct Recording {
+    Recorder single;
+    SegmentedRecorder segmented;
+    bool rotating = false;
+    bool active = false;
+};
 
 /**
- * @brief Tries to push a data message from the RT thread into the queue
- *
- * This function is called by the high-frequency RT thread to send data back
- * to the Observer thread. It is non-blocking; if the queue is full, it will
- * immediately return false, dropping the message
- *
- * @param queue The queue to push the message into
- * @param message The Message object containing the data to be pushed
- * @return true if the message was successfully pushed, false if the queue was full
+ * @brief Stops recording, writing out whatever is still buffered
  */
-bool try_push(Ring &queue, const Message &message) {
-    size_t h = queue.head.load(std::memory_order_relaxed);
-    size_t t = queue.tail.load(std::memory_order_acquire); 
-    if (h-t == std::size(queue.buf)) // full 
-        return false;
-
-    queue.buf[h & 7] = message; 
-    queue.head.store(h+1, std::memory_order_release); 
-    return true;
+void recording_close(Recording &recording) {
+    if (!recording.active)
+        return;
+    if (recording.rotating)
+        segmented_close(recording.segmented);
+    else
+        recorder_close(recording.single);
+    recording.active = false;
 }
 
 /**
- * @brief Tries to pop a data message from the queue for the Observer thread.
- *
- * This function is called by the low-frequency Observer thread to read data
- * sent by the RT thread. It is non-blocking; if the queue is empty, it will
- * immediately return false
- *
- * @param queue The queue to pop the message from
- * @param[out] out The Message object where the popped data will be stored
- * @return true if a message was successfully popped, false if the queue was empty
+ * @brief Prints everything the RT thread has sent since the last drain
+ * @param rx The telemetry channel to drain
+ * @param recording If active, every sample is also appended to this recording
+ * @param sketches Quantile sketches every drained batch is added to
+ * @param spectrum Spectral analyzer every drained batch is added to
+ * @param exported If set, every sample is also forwarded into this shared-memory ring
  */
-bool try_pop(Ring &queue, Message &out){
-    size_t t = queue.tail.load(std::memory_order_relaxed); 
-    size_t h = queue.head.load(std::memory_order_acquire);
-    if (t==h){ // empty
-        return false;
-    }
-
-    out = queue.buf[t & 7];
-    queue.tail.store(t+1, std::memory_order_release);
-    return true;
+void drain_telemetry(Telemetry &rx, Recording &recording, Sketches &sketches, Spectrum &spectrum,
+                     ExportRing *exported) {
+    std::vector<Sample<Message>> batch;
+    telemetry_drain(rx,
+        [](const TelemetryEvent &event) {
+            printf("  ! RT event %u at cycle %llu: %f\n", event.code,
+                   static_cast<unsigned long long>(event.cycle), event.value);
+        },
+        [&recording, &batch, exported](const Sample<Message> &sample) {
+            printf("  > Popped RT values: %f\n", sample.msg.arrayOfNumbers[0]);
+            if (recording.active
+                && !(recording.rotating ? segmented_append_sample(recording.segmented, sample)
+                                        : recorder_append_sample(recording.single, sample))) {
+                fprintf(stderr, "recording stopped: a chunk could not be written\n");
+                recording_close(recording);
+            }
+            if (exported != nullptr)
+                try_push(*exported, sample); // a slow bridge only loses exported samples
+            batch.push_back(sample);
+        });
+    sketch_add_samples(sketches, batch.data(), batch.size());
+    spectrum_add_samples(spectrum, batch.data(), batch.size());
 }
 
 /**
- * @brief The main function for the high-frequency Real-Time (RT) thread.
+ * @brief The main entry point of the program, acting as the low-frequency Observer thread.
  *
- * This function runs in a continuous loop at a fixed rate (20ms). In each
- * cycle, it peeks at the CommandMailbox to get the latest command from the
- * Observer thread. It then uses that command to generate a new data message,
- * which it pushes into the outgoing Ring queue.
+ * This function initializes the communication
+ * channels, launches the high-frequency RT thread, and then enters a loop where it
+ * simulates the work of an observer, sending new commands to the RT thread and
+ * periodically draining the data queue to process the results
  *
- * @param tx The Ring queue to push outgoing data messages into.
- * @param mailbox The Mailbox to peek for incoming commands from.
+ * Usage: spsc_app [--record PATH [--live NAME] [--rotate-mb N [--keep N]]]
+ *                 [--commands PATH] [--export NAME] [--rt-cpu N] [--rt-priority P]
+ *
+ * With --rotate-mb, PATH is the base name of `PATH.NNNNNN.rec` segments of N
+ * MiB each, of which the newest --keep are kept (all if 0).
  */
-void continuousThreadFunction(Ring &tx, Mailbox &mailbox){
-    int i= 0;
-    auto wake_up = std::chrono::high_resolution_clock::now();
-
-    while(true) {
-        wake_up += std::chrono::milliseconds(20);
-        i+=1;
-
-        Message command = peek(mailbox);
+int main(int argc, char **argv) {
+    printf("hello world\n");
 
-        if (!command.keepRunning) {
-            break;
+    const char *record_path = nullptr;
+    const char *live_name = nullptr;
+    const char *commands_path = nullptr;
+    const char *export_name = nullptr;
+    uint64_t rotate_mb = 0;
+    size_t keep_segments = 0;
+    RtThreadConfig rt_config;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--record") == 0) {
+            record_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--live") == 0) {
+            live_name = argv[i + 1];
+        } else if (strcmp(argv[i], "--rotate-mb") == 0) {
+            rotate_mb = strtoull(argv[i + 1], nullptr, 10);
+        } else if (strcmp(argv[i], "--keep") == 0) {
+            keep_segments = strtoull(argv[i + 1], nullptr, 10);
+        } else if (strcmp(argv[i], "--commands") == 0) {
+            commands_path = argv[i + 1];
+        } else if (strcmp(argv[i], "--export") == 0) {
+            export_name = argv[i + 1];
+        } else if (strcmp(argv[i], "--rt-cpu") == 0) {
+            rt_config.cpu = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--rt-priority") == 0) {
+            rt_config.priority = atoi(argv[i + 1]);
         }
+    }
 
-        Message message = {};
-        message.keepRunning = true;
-        message.arrayOfNumbers[0] = command.arrayOfNumbers[0] + static_cast<float>(i);
+    Recording recording;
+    recording.rotating = rotate_mb > 0;
+    Recorder &recorder = recording.rotating ? recording.segmented.current : recording.single;
+    if (live_name != nullptr && record_path != nullptr) {
+        recorder.live = live_create(live_name);
+        if (recorder.live == nullptr) {
+            fprintf(stderr, "cannot create live header %s\n", live_name);
+            return 1;
+        }
+    }
+    if (record_path != nullptr) {
+        if (recording.rotating) {
+            SegmentedRecorder &segmented = recording.segmented;
+            segmented.base = record_path;
+            segmented.segment_bytes = rotate_mb << 20;
+            segmented.keep_segments = keep_segments;
+            segmented.axes = Message::axes;
+            segmented.value_type = value_type_of<Message::value_type>();
+            segmented.chunk_records = 4096;
+            recording.active = segmented_open(segmented);
+        } else {
+            recording.active = recorder_open(recorder, record_path, Message::axes,
+                                             value_type_of<Message::value_type>());
+        }
+        if (!recording.active) {
+            fprintf(stderr, "cannot create recording %s\n", record_path);
+            return 1;
+        }
+    }
 
-        try_push(tx, message);
-        printf("  RT Thread Pushed:  %f\n", message.arrayOfNumbers[0]);
-        std::this_thread::sleep_until(wake_up);
+    int commands_fd = -1;
+    if (commands_path != nullptr) {
+        commands_fd = command_log_create<Message>(commands_path);
+        if (commands_fd < 0) {
+            fprintf(stderr, "cannot create command log %s\n", commands_path);
+            return 1;
+        }
     }
-}
 
-/**
- * @brief The main entry point of the program, acting as the low-frequency Observer thread.
- *
- * This function initializes the communication
- * channels, launches the high-frequency RT thread, and then enters a loop where it
- * simulates the work of an observer, sending new commands to the RT thread and
- * periodically draining the data queue to process the results
- */
-int main() {
-    printf("hello world\n");
+    ExportRing *exported = nullptr;
+    if (export_name != nullptr) {
+        exported = shm_channel_create<ExportRing>(export_name);
+        if (exported == nullptr) {
+            fprintf(stderr, "cannot create export ring %s\n", export_name);
+            return 1;
+        }
+    }
 
     // These are what actually hold the data that are being read and written to
-    Ring rtToMain;
+    Telemetry rtToMain;
     Mailbox mainToRT;
+    Commands commandLog;
+    if (!command_log_init(commandLog)) {
+        fprintf(stderr, "cannot map the command log ring\n");
+        return 1;
+    }
+    static Sketches sketches; // large; kept off the stack
+    sketch_init(sketches, 0.01);
+    static Spectrum spectrum;
+    spectrum_init(spectrum, 0.25f, RT_SUBSAMPLES);
 
     Message command = {};
     command.keepRunning = true;
     command.arrayOfNumbers[0] = 0.0f;
     send_command(mainToRT, command);
 
-    std::thread t(continuousThreadFunction, std::ref(rtToMain), std::ref(mainToRT));
+    std::thread t = rt_thread_launch(rt_config, continuousThreadFunction,
+                                     std::ref(rtToMain), std::ref(mainToRT), std::ref(commandLog));
     auto wake_up = std::chrono::high_resolution_clock::now();
 
     // Loop a few times, sending a new command each time
@@ -199,11 +234,10 @@ int main() {
         std::this_thread::sleep_until(wake_up);
 
         // Now drain the rt queue to see what the RT thread produced
-        Message message;
         printf("Observer reading from RT queue:\n");
-        while (try_pop(rtToMain, message)) {
-            printf("  > Popped RT values: %f\n", message.arrayOfNumbers[0]);
-        }
+        drain_telemetry(rtToMain, recording, sketches, spectrum, exported);
+        if (commands_fd >= 0)
+            command_log_drain(commandLog, commands_fd);
     }
 
     // Tells real-time thread to shut down
@@ -213,6 +247,27 @@ int main() {
 
     // Wait for the thread to finish
     t.join();
+    drain_telemetry(rtToMain, recording, sketches, spectrum, exported);
+    if (commands_fd >= 0) {
+        command_log_drain(commandLog, commands_fd);
+        close(commands_fd);
+        if (commandLog.overflows.load(std::memory_order_relaxed) > 0)
+            fprintf(stderr, "command log overflowed, it cannot be replayed\n");
+    }
+    command_log_destroy(commandLog);
+    recording_close(recording);
+    if (recorder.live != nullptr)
+        live_close(recorder.live, live_name);
+    if (exported != nullptr)
+        shm_channel_detach(exported, export_name);
+    printf("RT values p50 %f, p99 %f\n", sketch_quantile(sketches.field[0], 0.50),
+           sketch_quantile(sketches.field[0], 0.99));
+    if (spectrum.frames > 0) {
+        const double rate_hz = 1e9 * RT_SUBSAMPLES / (static_cast<double>(RT_PERIOD_NS) * spectrum.decimation);
+        printf("RT values dominant frequency %.2f Hz (%llu spectra, %llu restarts)\n",
+               spectrum_bin_hz(spectrum, spectrum_peak(spectrum, 0), rate_hz),
+               static_cast<unsigned long long>(spectrum.frames), static_cast<unsigned long long>(spectrum.resets));
+    }
     printf("done \n");
 
     return 0;
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+
+/*
+ * Named tunables for the RT loop. Keys live in a fixed-capacity,
+ * open-addressing (linear probing) table and are resolved to slot handles
+ * once, at startup; after that the RT thread reads a value by indexing the
+ * slot, with no hashing, string compares or locks.
+ *
+ * Each value is guarded by its own seqlock, like LiveHeader::generation:
+ * `sequence` is odd while the observer rewrites the value and is bumped to
+ * the next even value afterwards. There must be a single writer (the
+ * observer). Keys are only defined before the RT thread starts.
+ */
+
+static const size_t PARAM_KEY_LENGTH = 32;
+
+/**
+ * @brief A resolved parameter; the slot index into ParamTable::entries.
+ */
+struct ParamHandle {
+    uint32_t slot = UINT32_MAX;
+};
+
+/**
+ * @brief One value and its seqlock, alone on its cache line(s).
+ */
+template <typename T>
+struct alignas(64) ParamEntry {
+    std::atomic<uint32_t> sequence{0};
+    T value;
+};
+
+/**
+ * @brief A fixed-capacity parameter dictionary.
+ *
+ * Keys are kept apart from the entries so the RT thread only ever touches
+ * the cache lines of the values it reads.
+ */
+template <typename T = double, size_t Capacity = 64>
+struct ParamTable {
+    static_assert(std::is_trivially_copyable_v<T>, "Parameter values must be trivial.");
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+    ParamEntry<T> entries[Capacity];
+    char keys[Capacity][PARAM_KEY_LENGTH] = {};
+    uint32_t count = 0;
+};
+
+/**
+ * @brief Whether a handle refers to a slot
+ */
+inline bool param_valid(ParamHandle handle) {
+    return handle.slot != UINT32_MAX;
+}
+
+/**
+ * @brief Whether a handle refers to a slot of a table of this capacity
+ */
+template <size_t Capacity>
+inline bool param_in_range(ParamHandle handle) {
+    return handle.slot < Capacity;
+}
+
+/**
+ * @brief FNV-1a hash of a key
+ */
+inline uint32_t param_hash(const char *key) {
+    uint32_t hash = 2166136261u;
+    for (const char *p = key; *p != '\0'; ++p)
+        hash = (hash ^ static_cast<uint8_t>(*p)) * 16777619u;
+    return hash;
+}
+
+/**
+ * @brief Looks a key up (startup and observer side only)
+ * @return The key's handle, or an invalid handle if it is not defined
+ */
+template <typename T, size_t Capacity>
+ParamHandle param_find(const ParamTable<T, Capacity> &table, const char *key) {
+    ParamHandle handle;
+    if (strlen(key) >= PARAM_KEY_LENGTH)
+        return handle;
+    for (size_t probe = 0, slot = param_hash(key) & (Capacity - 1); probe < Capacity;
+         ++probe, slot = (slot + 1) & (Capacity - 1)) {
+        if (table.keys[slot][0] == '\0')
+            break;
+        if (strcmp(table.keys[slot], key) == 0) {
+            handle.slot = static_cast<uint32_t>(slot);
+            break;
+        }
+    }
+    return handle;
+}
+
+/**
+ * @brief Defines a key with an initial value, before the RT thread starts
+ *
+ * Defining a key that already exists keeps its current value and returns
+ * its handle, so independent modules can share a tunable by name.
+ *
+ * @param table The table to add to
+ * @param key The key, shorter than PARAM_KEY_LENGTH and not empty
+ * @param initial The value a new key starts with
+ * @param[out] handle The key's handle
+ * @return false if the key is invalid or the table is full
+ */
+template <typename T, size_t Capacity>
+bool param_define(ParamTable<T, Capacity> &table, const char *key, const T &initial, ParamHandle &handle) {
+    const size_t length = strlen(key);
+    if (length == 0 || length >= PARAM_KEY_LENGTH)
+        return false;
+    for (size_t probe = 0, slot = param_hash(key) & (Capacity - 1); probe < Capacity;
+         ++probe, slot = (slot + 1) & (Capacity - 1)) {
+        if (strcmp(table.keys[slot], key) == 0) {
+            handle.slot = static_cast<uint32_t>(slot);
+            return true;
+        }
+        if (table.keys[slot][0] == '\0') {
+            memcpy(table.keys[slot], key, length + 1);
+            table.entries[slot].value = initial;
+            table.entries[slot].sequence.store(0, std::memory_order_release);
+            table.count += 1;
+            handle.slot = static_cast<uint32_t>(slot);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Publishes a new value for a parameter (observer side)
+ * @return false if the handle does not refer to a slot of this table
+ */
+template <typename T, size_t Capacity>
+bool param_set(ParamTable<T, Capacity> &table, ParamHandle handle, const T &value) {
+    if (!param_in_range<Capacity>(handle))
+        return false;
+    ParamEntry<T> &entry = table.entries[handle.slot];
+    const uint32_t s = entry.sequence.load(std::memory_order_relaxed);
+    entry.sequence.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    entry.value = value;
+
+    entry.sequence.store(s + 2, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Publishes a new value by key (observer side)
+ * @return false if the key is not defined
+ */
+template <typename T, size_t Capacity>
+bool param_set(ParamTable<T, Capacity> &table, const char *key, const T &value) {
+    const ParamHandle handle = param_find(table, key);
+    if (!param_valid(handle))
+        return false;
+    return param_set(table, handle, value);
+}
+
+/**
+ * @brief Reads a parameter once, without waiting (RT side)
+ *
+ * Fails while the observer is in the middle of rewriting this value;
+ * the RT thread can then keep using the value it read last cycle.
+ *
+ * @param table The table to read from
+ * @param handle A handle from param_define() or param_find()
+ * @param[out] value The value, if the read was consistent
+ * @return false if the read raced with a write or the handle is invalid
+ */
+template <typename T, size_t Capacity>
+bool param_try_get(const ParamTable<T, Capacity> &table, ParamHandle handle, T &value) {
+    if (!param_in_range<Capacity>(handle))
+        return false;
+    const ParamEntry<T> &entry = table.entries[handle.slot];
+    const uint32_t before = entry.sequence.load(std::memory_order_acquire);
+    if (before & 1)
+        return false;
+    T copy;
+    memcpy(&copy, &entry.value, sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (entry.sequence.load(std::memory_order_relaxed) != before)
+        return false;
+    value = copy;
+    return true;
+}
+
+/**
+ * @brief Reads a parameter, retrying while the observer rewrites it (RT side)
+ *
+ * A write is a single copy of `T`, so a retry is rare and short. An invalid
+ * handle reads as a value-initialized `T`.
+ */
+template <typename T, size_t Capacity>
+T param_get(const ParamTable<T, Capacity> &table, ParamHandle handle) {
+    T value{};
+    if (!param_in_range<Capacity>(handle))
+        return value;
+    while (!param_try_get(table, handle, value)) {
+    }
+    return value;
+}
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+#include "simd.h"
+#include "telemetry.h"
+
+/**
+ * @brief One sign's worth of log buckets: a window of `Bins` consecutive keys.
+ *
+ * When a key above the window arrives the window slides up and the lowest
+ * buckets are collapsed into the new lowest one, so accuracy is only ever
+ * given up for the values closest to zero.
+ */
+template <size_t Bins>
+struct SketchStore {
+    int32_t offset = 0; // key of bins[0]
+    int32_t max_key = 0;
+    bool empty = true;
+    uint32_t bins[Bins] = {};
+};
+
+/**
+ * @brief A constant-memory, mergeable quantile sketch (DDSketch style).
+ *
+ * Every quantile is answered with a relative error of at most `accuracy` as
+ * long as no buckets had to be collapsed. Values of either sign are counted
+ * in logarithmically sized buckets; bucket keys come from log_bucket_keys(),
+ * which reads them off the float bits instead of calling log(). Two sketches
+ * with the same accuracy and number of bins merge exactly, so per-channel or
+ * per-window sketches can be combined afterwards.
+ */
+template <size_t Bins = 1024>
+struct QuantileSketch {
+    double accuracy = 0.0;
+    double multiplier = 0.0; // buckets per unit of log2
+
+    SketchStore<Bins> positive;
+    SketchStore<Bins> negative;
+    uint64_t zero_count = 0;
+
+    uint64_t count = 0;
+    double min = INFINITY;
+    double max = -INFINITY;
+    double sum = 0.0;
+};
+
+/**
+ * @brief Empties a sketch and sets its relative accuracy
+ * @param sketch The sketch to initialize
+ * @param accuracy Relative accuracy, e.g. 0.01 for 1%
+ */
+template <size_t Bins>
+void sketch_init(QuantileSketch<Bins> &sketch, double accuracy) {
+    sketch = QuantileSketch<Bins>();
+    sketch.accuracy = accuracy;
+    sketch.multiplier = 1.0 / log((1.0 + accuracy) / (1.0 - accuracy));
+}
+
+/**
+ * @brief Moves the window of a store so that it starts at `offset`
+ *
+ * Buckets that fall below the new window are added to its lowest bucket.
+ */
+template <size_t Bins>
+void sketch_store_shift(SketchStore<Bins> &store, int32_t offset) {
+    uint32_t moved[Bins] = {};
+    for (size_t i = 0; i < Bins; ++i) {
+        if (store.bins[i] == 0)
+            continue;
+        int64_t j = static_cast<int64_t>(store.offset) + static_cast<int64_t>(i) - offset;
+        moved[j < 0 ? 0 : j] += store.bins[i];
+    }
+    memcpy(store.bins, moved, sizeof(moved));
+    store.offset = offset;
+}
+
+/**
+ * @brief Counts `n` values with log bucket `key`
+ */
+template <size_t Bins>
+void sketch_store_add(SketchStore<Bins> &store, int32_t key, uint32_t n) {
+    constexpr int32_t width = static_cast<int32_t>(Bins);
+    if (store.empty) {
+        store.empty = false;
+        store.offset = key - width / 2;
+        store.max_key = key;
+    }
+
+    if (key >= store.offset + width) {
+        sketch_store_shift(store, key - width + 1);
+    } else if (key < store.offset) {
+        if (store.max_key - key < width)
+            sketch_store_shift(store, key);
+        else
+            key = store.offset; // collapse into the lowest bucket
+    }
+    store.max_key = key > store.max_key ? key : store.max_key;
+    store.bins[key - store.offset] += n;
+}
+
+/**
+ * @brief Adds one value to a sketch. NaN and infinities are ignored
+ */
+template <size_t Bins>
+void sketch_add(QuantileSketch<Bins> &sketch, double value) {
+    if (!isfinite(value))
+        return;
+    const double magnitude = fabs(value);
+    if (magnitude < FLT_MIN)
+        sketch.zero_count += 1;
+    else
+        sketch_store_add(value > 0 ? sketch.positive : sketch.negative, log_bucket_key(magnitude, sketch.multiplier), 1);
+
+    sketch.count += 1;
+    sketch.min = value < sketch.min ? value : sketch.min;
+    sketch.max = value > sketch.max ? value : sketch.max;
+    sketch.sum += value;
+}
+
+/**
+ * @brief Adds a column of values to a sketch
+ *
+ * The bucket keys are computed in blocks with the vectorized
+ * log_bucket_keys(); only the bucket increments are done one by one.
+ *
+ * @param sketch The sketch to update
+ * @param values The column
+ * @param n Number of values
+ */
+template <size_t Bins>
+void sketch_add_batch(QuantileSketch<Bins> &sketch, const float *values, size_t n) {
+    constexpr size_t BLOCK = 256;
+    int32_t keys[BLOCK];
+
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t len = n - start < BLOCK ? n - start : BLOCK;
+        log_bucket_keys(values + start, len, sketch.multiplier, keys);
+
+        for (size_t i = 0; i < len; ++i) {
+            const float value = values[start + i];
+            if (!isfinite(value))
+                continue;
+            if (fabsf(value) < FLT_MIN)
+                sketch.zero_count += 1;
+            else
+                sketch_store_add(value > 0 ? sketch.positive : sketch.negative, keys[i], 1);
+
+            sketch.count += 1;
+            sketch.min = value < sketch.min ? value : sketch.min;
+            sketch.max = value > sketch.max ? value : sketch.max;
+            sketch.sum += value;
+        }
+    }
+}
+
+/**
+ * @brief Adds everything counted in `from` to `into`
+ * @return false if the sketches were made with different accuracies
+ */
+template <size_t Bins>
+bool sketch_merge(QuantileSketch<Bins> &into, const QuantileSketch<Bins> &from) {
+    if (from.count == 0)
+        return true;
+    if (into.multiplier != from.multiplier)
+        return false;
+
+    const SketchStore<Bins> *sources[2] = {&from.positive, &from.negative};
+    SketchStore<Bins> *targets[2] = {&into.positive, &into.negative};
+    for (size_t s = 0; s < 2; ++s) {
+        if (sources[s]->empty)
+            continue;
+        // Highest keys first, so the target window only ever needs to slide down
+        for (size_t i = Bins; i-- > 0;) {
+            if (sources[s]->bins[i] > 0)
+                sketch_store_add(*targets[s], sources[s]->offset + static_cast<int32_t>(i), sources[s]->bins[i]);
+        }
+    }
+
+    into.zero_count += from.zero_count;
+    into.count += from.count;
+    into.min = from.min < into.min ? from.min : into.min;
+    into.max = from.max > into.max ? from.max : into.max;
+    into.sum += from.sum;
+    return true;
+}
+
+/**
+ * @brief Estimates the `q`-quantile of everything added to a sketch
+ * @param sketch The sketch to query
+ * @param q Quantile between 0 and 1, e.g. 0.99
+ * @return The estimate, or NaN if the sketch is empty
+ */
+template <size_t Bins>
+double sketch_quantile(const QuantileSketch<Bins> &sketch, double q) {
+    if (sketch.count == 0)
+        return NAN;
+    const double rank = q * static_cast<double>(sketch.count - 1);
+
+    // Representative of a bucket: within `accuracy` of every value in it
+    auto bucket_value = [&sketch](int32_t key) {
+        const double lo = log_bucket_lower(key, sketch.multiplier);
+        const double hi = log_bucket_lower(key + 1, sketch.multiplier);
+        return 2.0 * lo * hi / (lo + hi);
+    };
+    auto clamp = [&sketch](double v) { return v < sketch.min ? sketch.min : v > sketch.max ? sketch.max : v; };
+
+    // Negative values from the largest magnitude down, then zeros, then positive values
+    double seen = 0.0;
+    for (size_t i = Bins; i-- > 0;) {
+        seen += sketch.negative.bins[i];
+        if (sketch.negative.bins[i] > 0 && seen > rank)
+            return clamp(-bucket_value(sketch.negative.offset + static_cast<int32_t>(i)));
+    }
+    seen += static_cast<double>(sketch.zero_count);
+    if (seen > rank)
+        return clamp(0.0);
+    for (size_t i = 0; i < Bins; ++i) {
+        seen += sketch.positive.bins[i];
+        if (sketch.positive.bins[i] > 0 && seen > rank)
+            return clamp(bucket_value(sketch.positive.offset + static_cast<int32_t>(i)));
+    }
+    return sketch.max;
+}
+
+/**
+ * @brief One quantile sketch per telemetry field.
+ */
+template <size_t Axes, size_t Bins = 1024>
+struct FieldSketches {
+    QuantileSketch<Bins> field[Axes];
+};
+
+/**
+ * @brief Initializes all field sketches with the same accuracy
+ */
+template <size_t Axes, size_t Bins>
+void sketch_init(FieldSketches<Axes, Bins> &sketches, double accuracy) {
+    for (auto &sketch : sketches.field)
+        sketch_init(sketch, accuracy);
+}
+
+/**
+ * @brief Adds a batch of drained samples, field by field
+ *
+ * The samples are transposed into a column per field so every field goes
+ * through the vectorized sketch_add_batch().
+ *
+ * @param sketches The sketches to update
+ * @param samples The drained samples
+ * @param n Number of samples
+ */
+template <typename Msg, size_t Bins>
+void sketch_add_samples(FieldSketches<Msg::axes, Bins> &sketches, const Sample<Msg> *samples, size_t n) {
+    static_assert(std::is_same_v<typename Msg::value_type, float>, "Field sketches take float samples.");
+    constexpr size_t BLOCK = 256;
+    float column[BLOCK];
+
+    for (size_t start = 0; start < n; start += BLOCK) {
+        const size_t len = n - start < BLOCK ? n - start : BLOCK;
+        for (size_t a = 0; a < Msg::axes; ++a) {
+            for (size_t i = 0; i < len; ++i)
+                column[i] = samples[start + i].msg.arrayOfNumbers[a];
+            sketch_add_batch(sketches.field[a], column, len);
+        }
+    }
+}
+
+/**
+ * @brief Merges every field of `from` into `into`
+ * @return false if the sketches were made with different accuracies
+ */
+template <size_t Axes, size_t Bins>
+bool sketch_merge(FieldSketches<Axes, Bins> &into, const FieldSketches<Axes, Bins> &from) {
+    bool ok = true;
+    for (size_t a = 0; a < Axes; ++a)
+        ok = sketch_merge(into.field[a], from.field[a]) && ok;
+    return ok;
+}
+
+/**
+ * @brief Field sketches over a sliding time window.
+ *
+ * The window is split into `Windows` slots of `slot_ns` each. Samples go into
+ * the slot of their timestamp; a slot is cleared when time moves past it, so
+ * memory stays constant however long the observer runs. Quantiles over the
+ * whole window come from merging the slots.
+ */
+template <size_t Axes, size_t Windows, size_t Bins = 1024>
+struct RollingSketches {
+    double accuracy = 0.0;
+    int64_t slot_ns = 0;
+    int64_t current_slot = INT64_MIN; // time_ns / slot_ns of the newest slot
+    FieldSketches<Axes, Bins> slots[Windows];
+};
+
+/**
+ * @brief The slot that holds time slot number `slot`
+ */
+template <size_t Axes, size_t Windows, size_t Bins>
+FieldSketches<Axes, Bins> &rolling_slot(RollingSketches<Axes, Windows, Bins> &rolling, int64_t slot) {
+    const int64_t windows = static_cast<int64_t>(Windows);
+    return rolling.slots[((slot % windows) + windows) % windows];
+}
+
+/**
+ * @brief Empties a rolling sketch and sets its accuracy and slot length
+ */
+template <size_t Axes, size_t Windows, size_t Bins>
+void rolling_init(RollingSketches<Axes, Windows, Bins> &rolling, double accuracy, int64_t slot_ns) {
+    rolling.accuracy = accuracy;
+    rolling.slot_ns = slot_ns;
+    rolling.current_slot = INT64_MIN;
+    for (auto &slot : rolling.slots)
+        sketch_init(slot, accuracy);
+}
+
+/**
+ * @brief Adds a batch of drained samples to the slots of their timestamps
+ *
+ * Runs of samples that fall into the same slot are added as one batch.
+ * Samples older than the window are dropped.
+ */
+template <typename Msg, size_t Windows, size_t Bins>
+void rolling_add_samples(RollingSketches<Msg::axes, Windows, Bins> &rolling, const Sample<Msg> *samples, size_t n) {
+    size_t start = 0;
+    while (start < n) {
+        const int64_t slot = samples[start].time_ns / rolling.slot_ns;
+        size_t end = start + 1;
+        while (end < n && samples[end].time_ns / rolling.slot_ns == slot)
+            ++end;
+
+        if (rolling.current_slot == INT64_MIN || slot > rolling.current_slot) {
+            // Clear the slots time has moved past, at most all of them
+            const int64_t first = rolling.current_slot == INT64_MIN || slot - rolling.current_slot > static_cast<int64_t>(Windows)
+                                ? slot - static_cast<int64_t>(Windows) + 1 : rolling.current_slot + 1;
+            for (int64_t s = first; s <= slot; ++s)
+                sketch_init(rolling_slot(rolling, s), rolling.accuracy);
+            rolling.current_slot = slot;
+        }
+        if (rolling.current_slot - slot < static_cast<int64_t>(Windows))
+            sketch_add_samples(rolling_slot(rolling, slot), samples + start, end - start);
+        start = end;
+    }
+}
+
+/**
+ * @brief Merges all slots into one set of field sketches covering the whole window
+ */
+template <size_t Axes, size_t Windows, size_t Bins>
+void rolling_merged(const RollingSketches<Axes, Windows, Bins> &rolling, FieldSketches<Axes, Bins> &out) {
+    sketch_init(out, rolling.accuracy);
+    for (const auto &slot : rolling.slots)
+        sketch_merge(out, slot);
+}
@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "quantile_sketch.h"
+#include "recording_reader.h"
+#include "simd.h"
+
+/*
+ * spsc_query: time-range filters and per-field aggregations over recordings.
+ *
+ * Chunks of all given recordings are scanned in parallel straight from their
+ * mappings (compressed chunks are decoded per chunk, independently), in a
+ * single pass: each chunk yields count/min/max/mean and threshold crossings,
+ * and each thread feeds its values into per-field quantile sketches that are
+ * merged at the end, so percentiles (within 1%) need neither the samples nor
+ * a second decode of every chunk.
+ */
+
+constexpr double PERCENTILE_ACCURACY = 0.01;
+
+using Sketch = QuantileSketch<>;
+
+struct QueryOptions {
+    std::vector<std::string> files;
+    int64_t from_ns = std::numeric_limits<int64_t>::min();
+    int64_t to_ns = std::numeric_limits<int64_t>::max();
+    bool has_threshold = false;
+    double threshold = 0.0;
+    unsigned threads = 0;
+};
+
+struct WorkItem {
+    size_t file;
+    size_t chunk;
+};
+
+/**
+ * @brief Aggregates of one field over some range of records.
+ */
+struct FieldStats {
+    uint64_t count = 0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    uint64_t crossings = 0;
+    double first = 0.0;
+    double last = 0.0;
+};
+
+/**
+ * @brief Turns a "seconds since the epoch" argument into nanoseconds
+ */
+static int64_t parse_time(const char *text) {
+    return static_cast<int64_t>(llround(strtod(text, nullptr) * 1e9));
+}
+
+/**
+ * @brief Maps a chunk and copies the in-range values of every field into columns
+ *
+ * `columns` is laid out field after field, each `count` values long.
+ *
+ * @return false if the chunk could not be mapped or decoded; `count` is 0 then
+ */
+static bool load_columns(const RecordingReader &reader, size_t chunk, const QueryOptions &options,
+                         std::vector<double> &columns, size_t &count) {
+    count = 0;
+    ChunkView view;
+    if (!reader_map_chunk(reader, chunk, view)) {
+        fprintf(stderr, "cannot read chunk %zu\n", chunk);
+        return false;
+    }
+
+    size_t lo = chunk_lower_bound(view, options.from_ns);
+    size_t hi = options.to_ns == std::numeric_limits<int64_t>::max() ? view.count
+                                                                     : chunk_lower_bound(view, options.to_ns + 1);
+    const size_t n = hi > lo ? hi - lo : 0;
+    const size_t axes = reader.header.axes;
+    columns.resize(n * axes);
+
+    // Transpose records into per-field columns for the vector kernels
+    for (size_t r = 0; r < n; ++r) {
+        const uint8_t *values = chunk_record_values(view, lo + r);
+        for (size_t a = 0; a < axes; ++a) {
+            double v;
+            if (reader.header.value_type == VALUE_F64) {
+                memcpy(&v, values + a * sizeof(double), sizeof(double));
+            } else {
+                float f;
+                memcpy(&f, values + a * sizeof(float), sizeof(float));
+                v = f;
+            }
+            columns[a * n + r] = v;
+        }
+    }
+    reader_unmap_chunk(view);
+    count = n;
+    return true;
+}
+
+/**
+ * @brief Runs `work(thread_index, item_index)` over all items on `threads` threads
+ */
+template <typename Work>
+static void parallel_for(size_t items, unsigned threads, Work &&work) {
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t]() {
+            for (size_t i = next.fetch_add(1); i < items; i = next.fetch_add(1))
+                work(t, i);
+        });
+    }
+    for (auto &thread : pool)
+        thread.join();
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: spsc_query [--from SECONDS] [--to SECONDS] [--threshold X] [--threads N] FILE...\n"
+            "  Times are CLOCK_REALTIME seconds since the epoch. Files must be given in time order.\n");
+}
+
+/**
+ * @brief Entry point of the query tool
+ */
+int main(int argc, char **argv) {
+    QueryOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            options.from_ns = parse_time(argv[++i]);
+        } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            options.to_ns = parse_time(argv[++i]);
+        } else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            options.has_threshold = true;
+            options.threshold = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = static_cast<unsigned>(atoi(argv[++i]));
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            options.files.push_back(argv[i]);
+        }
+    }
+    if (options.files.empty()) {
+        usage();
+        return 2;
+    }
+    if (options.threads == 0)
+        options.threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+
+    std::vector<RecordingReader> readers(options.files.size());
+    std::vector<WorkItem> items;
+    for (size_t f = 0; f < options.files.size(); ++f) {
+        if (!reader_open(readers[f], options.files[f].c_str())) {
+            fprintf(stderr, "cannot open recording %s\n", options.files[f].c_str());
+            return 1;
+        }
+        if (readers[f].header.axes != readers[0].header.axes
+            || readers[f].header.value_type != readers[0].header.value_type) {
+            fprintf(stderr, "%s has a different layout than %s\n", options.files[f].c_str(), options.files[0].c_str());
+            return 1;
+        }
+
+        // The index lets whole chunks outside the range be skipped without mapping them
+        for (size_t c = reader_seek(readers[f], options.from_ns); c < readers[f].index.size(); ++c) {
+            if (readers[f].index[c].first_time_ns > options.to_ns)
+                break;
+            items.push_back({f, c});
+        }
+    }
+    const size_t axes = readers[0].header.axes;
+
+    // Count, min, max, sum and crossings per chunk; percentiles into one sketch per thread and field
+    std::vector<FieldStats> partial(items.size() * axes);
+    std::vector<Sketch> sketches(static_cast<size_t>(options.threads) * axes);
+    for (auto &sketch : sketches)
+        sketch_init(sketch, PERCENTILE_ACCURACY);
+    std::atomic<size_t> unreadable{0};
+    parallel_for(items.size(), options.threads, [&](unsigned t, size_t i) {
+        std::vector<double> columns;
+        size_t n;
+        if (!load_columns(readers[items[i].file], items[i].chunk, options, columns, n))
+            unreadable.fetch_add(1, std::memory_order_relaxed);
+        for (size_t a = 0; a < axes && n > 0; ++a) {
+            FieldStats &stats = partial[i * axes + a];
+            const double *column = columns.data() + a * n;
+            column_min_max_sum(column, n, stats.min, stats.max, stats.sum);
+            stats.count = n;
+            stats.first = column[0];
+            stats.last = column[n - 1];
+            if (options.has_threshold)
+                stats.crossings = column_crossings(column, n, options.threshold);
+
+            Sketch &sketch = sketches[static_cast<size_t>(t) * axes + a];
+            for (size_t r = 0; r < n; ++r)
+                sketch_add(sketch, column[r]);
+        }
+    });
+    for (unsigned t = 1; t < options.threads; ++t) {
+        for (size_t a = 0; a < axes; ++a)
+            sketch_merge(sketches[a], sketches[static_cast<size_t>(t) * axes + a]);
+    }
+
+    // Merge in recording order so crossings at chunk boundaries are counted too
+    std::vector<FieldStats> total(axes);
+    for (size_t i = 0; i < items.size(); ++i) {
+        for (size_t a = 0; a < axes; ++a) {
+            const FieldStats &part = partial[i * axes + a];
+            FieldStats &sum = total[a];
+            if (part.count == 0)
+                continue;
+            if (options.has_threshold && sum.count > 0 && sum.last <= options.threshold && part.first > options.threshold)
+                sum.crossings += 1;
+            sum.count += part.count;
+            sum.min = part.min < sum.min ? part.min : sum.min;
+            sum.max = part.max > sum.max ? part.max : sum.max;
+            sum.sum += part.sum;
+            sum.crossings += part.crossings;
+            sum.last = part.last;
+        }
+    }
+
+    printf("%-6s %12s %14s %14s %14s %14s %14s %14s", "field", "count", "min", "max", "mean", "p50", "p90", "p99");
+    if (options.has_threshold)
+        printf(" %10s", "crossings");
+    printf("\n");
+    for (size_t a = 0; a < axes; ++a) {
+        const FieldStats &stats = total[a];
+        if (stats.count == 0) {
+            printf("%-6zu %12d\n", a, 0);
+            continue;
+        }
+        const Sketch &sketch = sketches[a];
+        printf("%-6zu %12llu %14.6g %14.6g %14.6g %14.6g %14.6g %14.6g", a,
+               static_cast<unsigned long long>(stats.count), stats.min, stats.max,
+               stats.sum / static_cast<double>(stats.count), sketch_quantile(sketch, 0.50),
+               sketch_quantile(sketch, 0.90), sketch_quantile(sketch, 0.99));
+        if (options.has_threshold)
+            printf(" %10llu", static_cast<unsigned long long>(stats.crossings));
+        printf("\n");
+    }
+
+    // Aggregates that skipped chunks must not pass for complete ones in scripts
+    const size_t skipped = unreadable.load(std::memory_order_relaxed);
+    if (skipped > 0)
+        printf("partial result: %zu of %zu chunk(s) could not be read\n", skipped, items.size());
+
+    for (auto &reader : readers)
+        reader_close(reader);
+    return skipped > 0 ? 1 : 0;
+}
@@ -0,0 +1,530 @@
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "direct_writer.h"
+#include "live_recording.h"
+#include "telemetry.h"
+
+/*
+ * Recording file format
+ *
+ * A recording is a data file plus a sparse time index next to it
+ * (`<path>.idx`). The data file starts with a RecordingHeader followed by
+ * chunks; each chunk is a ChunkHeader followed by `count` fixed-size records.
+ * A record is a RecordPrefix followed by `axes` values of the recorded value
+ * type. The index file is an IndexHeader followed by one IndexEntry per chunk,
+ * appended as each chunk is written, so a reader can binary-search time and
+ * map only the chunks it needs. All integers are little-endian.
+ *
+ * A chunk whose header carries CHUNK_XOR_RLE_MAGIC instead of CHUNK_MAGIC is
+ * compressed with chunk_encode(): every record is XORed with the previous one
+ * and the result is run-length coded. Each chunk decodes on its own, so
+ * readers can still map and decode chunks independently and in parallel.
+ */
+
+constexpr uint32_t RECORDING_MAGIC = 0x43525053; // "SPRC"
+constexpr uint32_t CHUNK_MAGIC = 0x4b4e4843;     // "CHNK"
+constexpr uint32_t CHUNK_XOR_RLE_MAGIC = 0x5a4b4843; // "CHKZ"
+constexpr uint32_t INDEX_MAGIC = 0x58444e49;     // "INDX"
+constexpr uint32_t RECORDING_VERSION = 1;
+
+enum ValueType : uint32_t {
+    VALUE_F32 = 0,
+    VALUE_F64 = 1,
+};
+
+struct RecordingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t axes;
+    uint32_t value_type;
+    uint32_t record_size;
+    uint32_t reserved[11];
+};
+
+struct ChunkHeader {
+    uint32_t magic; // CHUNK_MAGIC or CHUNK_XOR_RLE_MAGIC
+    uint32_t count;
+    uint64_t payload_bytes;
+    int64_t first_time_ns;
+    int64_t last_time_ns;
+};
+
+struct RecordPrefix {
+    int64_t time_ns;
+    uint64_t cycle;
+    uint32_t decimation;
+    uint32_t subsample;
+};
+
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+};
+
+struct IndexEntry {
+    int64_t first_time_ns;
+    int64_t last_time_ns;
+    uint64_t offset; // of the ChunkHeader in the data file
+    uint64_t payload_bytes; // as stored, i.e. after compression
+    uint32_t count;
+    uint32_t compressed;
+};
+
+static_assert(sizeof(RecordingHeader) == 64, "RecordingHeader layout changed.");
+static_assert(sizeof(ChunkHeader) == 32, "ChunkHeader layout changed.");
+static_assert(sizeof(RecordPrefix) == 24, "RecordPrefix layout changed.");
+static_assert(sizeof(IndexEntry) == 40, "IndexEntry layout changed.");
+
+/**
+ * @brief Size of one value of the given type in bytes
+ */
+inline size_t value_type_size(uint32_t value_type) {
+    return value_type == VALUE_F64 ? sizeof(double) : sizeof(float);
+}
+
+/**
+ * @brief The ValueType code for a message value type
+ */
+template <typename T>
+constexpr uint32_t value_type_of() {
+    static_assert(std::is_same_v<T, float> || std::is_same_v<T, double>, "Only float and double can be recorded.");
+    return std::is_same_v<T, double> ? VALUE_F64 : VALUE_F32;
+}
+
+/**
+ * @brief Writes the whole buffer at the given file offset, retrying short writes
+ * @return true if everything was written
+ */
+inline bool pwrite_all(int fd, const void *data, size_t len, uint64_t offset) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        len -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief Compresses a chunk payload (XOR with the previous record, then run-length coding)
+ *
+ * The output is a sequence of control bytes: `c < 128` is followed by `c + 1`
+ * literal bytes, `c >= 128` stands for `c - 127` zero bytes.
+ *
+ * @param raw The records of the chunk
+ * @param len Size of the records in bytes
+ * @param record_size Size of one record
+ * @param[out] out The encoded payload
+ */
+inline void chunk_encode(const uint8_t *raw, size_t len, size_t record_size, std::vector<uint8_t> &out) {
+    out.clear();
+    size_t literal_at = 0; // position of the pending literal control byte in out
+    size_t literal_len = 0;
+    size_t zeros = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        const uint8_t b = i >= record_size ? raw[i] ^ raw[i - record_size] : raw[i];
+        if (b == 0) {
+            literal_len = 0;
+            if (++zeros == 128) {
+                out.push_back(static_cast<uint8_t>(127 + zeros));
+                zeros = 0;
+            }
+            continue;
+        }
+        if (zeros > 0) {
+            out.push_back(static_cast<uint8_t>(127 + zeros));
+            zeros = 0;
+        }
+        if (literal_len == 0 || literal_len == 128) {
+            literal_at = out.size();
+            out.push_back(0);
+            literal_len = 0;
+        }
+        out[literal_at] = static_cast<uint8_t>(literal_len);
+        out.push_back(b);
+        literal_len += 1;
+    }
+    if (zeros > 0)
+        out.push_back(static_cast<uint8_t>(127 + zeros));
+}
+
+/**
+ * @brief Decompresses a payload written by chunk_encode()
+ * @param in The encoded payload
+ * @param in_len Size of the encoded payload
+ * @param record_size Size of one record
+ * @param[out] raw Where the records are reconstructed
+ * @param raw_len Expected size of the records in bytes
+ * @return true if the payload decoded to exactly raw_len bytes
+ */
+inline bool chunk_decode(const uint8_t *in, size_t in_len, size_t record_size, uint8_t *raw, size_t raw_len) {
+    size_t o = 0;
+    size_t i = 0;
+    while (i < in_len) {
+        const uint8_t c = in[i++];
+        if (c < 128) {
+            const size_t n = static_cast<size_t>(c) + 1;
+            if (i + n > in_len || o + n > raw_len)
+                return false;
+            memcpy(raw + o, in + i, n);
+            i += n;
+            o += n;
+        } else {
+            const size_t n = static_cast<size_t>(c) - 127;
+            if (o + n > raw_len)
+                return false;
+            memset(raw + o, 0, n);
+            o += n;
+        }
+    }
+    if (o != raw_len)
+        return false;
+
+    for (size_t k = record_size; k < raw_len; ++k)
+        raw[k] ^= raw[k - record_size];
+    return true;
+}
+
+/**
+ * @brief Observer-side writer for recording files.
+ *
+ * Records are collected into an in-memory chunk and written, together with
+ * the chunk's index entry, once `chunk_records` records have accumulated (or
+ * on recorder_flush/recorder_close). The Recorder is meant for the Observer or
+ * a dedicated drain thread, never for the RT thread. With `compress` set,
+ * chunks are written with chunk_encode().
+ *
+ * If `map` is set, the data file was preallocated and mapped up front (see
+ * SegmentedRecorder) and chunks are copied into the mapping instead of going
+ * through pwrite; anything past `map_size` still falls back to pwrite. If
+ * `direct` is set (see recorder_open_direct), the data file is written by an
+ * asynchronous O_DIRECT DirectWriter instead.
+ *
+ * If `live` is set, the recorder publishes the file it writes and its
+ * committed size there after every chunk, so viewers can follow it live.
+ *
+ * A failed chunk write leaves the file in an unknown state, so it latches
+ * `failed`: the pending chunk is dropped and every later append and flush
+ * returns false until the recorder is started again.
+ */
+struct Recorder {
+    int fd = -1;
+    int index_fd = -1;
+    uint64_t offset = 0;
+    uint64_t index_offset = 0;
+
+    uint8_t *map = nullptr;
+    uint64_t map_size = 0;
+    DirectWriter *direct = nullptr;
+    LiveHeader *live = nullptr;
+
+    uint32_t axes = 0;
+    uint32_t value_type = VALUE_F32;
+    uint32_t record_size = 0;
+    uint32_t chunk_records = 0;
+    bool compress = false;
+
+    std::vector<uint8_t> chunk;
+    std::vector<uint8_t> encoded;
+    uint32_t chunk_count = 0;
+    int64_t chunk_first_time = 0;
+    int64_t chunk_last_time = 0;
+    uint64_t chunks_written = 0;
+    bool failed = false;
+};
+
+/**
+ * @brief Writes to the data file, through the mapping when the range is mapped
+ * @return true if everything was written
+ */
+inline bool recorder_write(Recorder &recorder, const void *data, size_t len, uint64_t offset) {
+    if (recorder.direct != nullptr) {
+        // The recorder only ever appends, which is all a DirectWriter supports
+        return offset == recorder.direct->size && direct_writer_append(*recorder.direct, data, len);
+    }
+    if (recorder.map != nullptr && offset + len <= recorder.map_size) {
+        memcpy(recorder.map + offset, data, len);
+        return true;
+    }
+    return pwrite_all(recorder.fd, data, len, offset);
+}
+
+/**
+ * @brief Starts a recording on already-open data and index files
+ *
+ * Writes both file headers. recorder_open() is the usual way in; this is for
+ * callers that create (and possibly preallocate and map) the files themselves.
+ *
+ * @param recorder The recorder to start
+ * @param fd The data file, empty
+ * @param index_fd The index file, empty
+ * @param map Mapping of the data file, or nullptr to write with pwrite
+ * @param map_size Size of the mapping in bytes
+ * @param axes Number of values per record
+ * @param value_type VALUE_F32 or VALUE_F64
+ * @param chunk_records Number of records per chunk
+ * @param compress Whether to compress chunks
+ * @param path Path of the data file, announced to `live` viewers if set
+ * @return true if the headers were written
+ */
+inline bool recorder_begin(Recorder &recorder, int fd, int index_fd, uint8_t *map, uint64_t map_size,
+                           uint32_t axes, uint32_t value_type, uint32_t chunk_records, bool compress,
+                           const char *path = nullptr) {
+    recorder.fd = fd;
+    recorder.index_fd = index_fd;
+    recorder.map = map;
+    recorder.map_size = map_size;
+    recorder.axes = axes;
+    recorder.value_type = value_type;
+    recorder.record_size = static_cast<uint32_t>(sizeof(RecordPrefix) + axes * value_type_size(value_type));
+    recorder.chunk_records = chunk_records;
+    recorder.compress = compress;
+    recorder.chunk.resize(sizeof(ChunkHeader) + static_cast<size_t>(chunk_records) * recorder.record_size);
+    recorder.chunk_count = 0;
+    recorder.chunks_written = 0;
+    recorder.failed = false;
+
+    RecordingHeader header = {};
+    header.magic = RECORDING_MAGIC;
+    header.version = RECORDING_VERSION;
+    header.axes = axes;
+    header.value_type = value_type;
+    header.record_size = recorder.record_size;
+
+    IndexHeader index_header = {INDEX_MAGIC, RECORDING_VERSION};
+
+    recorder.offset = 0;
+    recorder.index_offset = 0;
+    if (!recorder_write(recorder, &header, sizeof(header), 0)
+        || !pwrite_all(recorder.index_fd, &index_header, sizeof(index_header), 0))
+        return false;
+    recorder.offset = sizeof(header);
+    recorder.index_offset = sizeof(index_header);
+    if (recorder.live != nullptr && path != nullptr) {
+        const uint64_t committed = recorder.direct != nullptr ? 0 : recorder.offset;
+        live_publish_file(*recorder.live, path, axes, value_type, recorder.record_size, committed);
+    }
+    return true;
+}
+
+/**
+ * @brief Creates a recording and its index file, truncating existing ones
+ * @param recorder The recorder to open
+ * @param path Path of the data file; the index is written to `<path>.idx`
+ * @param axes Number of values per record
+ * @param value_type VALUE_F32 or VALUE_F64
+ * @param chunk_records Number of records per chunk
+ * @param compress Whether to compress chunks
+ * @return true if both files were created
+ */
+inline bool recorder_open(Recorder &recorder, const char *path, uint32_t axes, uint32_t value_type,
+                          uint32_t chunk_records = 4096, bool compress = false) {
+    const std::string index_path = std::string(path) + ".idx";
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    int index_fd = open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || index_fd < 0) {
+        if (fd >= 0)
+            close(fd);
+        if (index_fd >= 0)
+            close(index_fd);
+        return false;
+    }
+    if (!recorder_begin(recorder, fd, index_fd, nullptr, 0, axes, value_type, chunk_records, compress, path)) {
+        close(fd);
+        close(index_fd);
+        recorder.fd = recorder.index_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Creates a recording whose data file is written with a DirectWriter
+ *
+ * For sustained high-rate recording: writes bypass the page cache and
+ * several are kept in flight. While writes are in flight the index may point
+ * at chunks that have not reached the file yet; direct_writer_committed()
+ * tells how far the data is complete.
+ *
+ * @param recorder The recorder to open
+ * @param writer The writer for the data file; must outlive the recorder
+ * @param path Path of the data file; the index is written to `<path>.idx`
+ * @param axes Number of values per record
+ * @param value_type VALUE_F32 or VALUE_F64
+ * @param chunk_records Number of records per chunk
+ * @param compress Whether to compress chunks
+ * @return true if both files were created
+ */
+inline bool recorder_open_direct(Recorder &recorder, DirectWriter &writer, const char *path, uint32_t axes,
+                                 uint32_t value_type, uint32_t chunk_records = 4096, bool compress = false) {
+    const std::string index_path = std::string(path) + ".idx";
+    if (!direct_writer_open(writer, path))
+        return false;
+    int index_fd = open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (index_fd < 0) {
+        direct_writer_close(writer);
+        return false;
+    }
+    recorder.direct = &writer;
+    if (!recorder_begin(recorder, writer.fd, index_fd, nullptr, 0, axes, value_type, chunk_records, compress, path)) {
+        direct_writer_close(writer);
+        close(index_fd);
+        recorder.direct = nullptr;
+        recorder.fd = recorder.index_fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes the current chunk (if it holds any records) and its index entry
+ * @param recorder The recorder to flush
+ * @return true if the chunk and index entry were written; false once the recorder has failed
+ */
+inline bool recorder_flush(Recorder &recorder) {
+    if (recorder.failed)
+        return false;
+    if (recorder.chunk_count == 0)
+        return true;
+
+    uint64_t payload = static_cast<uint64_t>(recorder.chunk_count) * recorder.record_size;
+    const uint8_t *body = recorder.chunk.data() + sizeof(ChunkHeader);
+    uint32_t magic = CHUNK_MAGIC;
+    if (recorder.compress) {
+        chunk_encode(body, payload, recorder.record_size, recorder.encoded);
+        if (recorder.encoded.size() < payload) {
+            body = recorder.encoded.data();
+            payload = recorder.encoded.size();
+            magic = CHUNK_XOR_RLE_MAGIC;
+        }
+    }
+
+    ChunkHeader header = {magic, recorder.chunk_count, payload,
+                          recorder.chunk_first_time, recorder.chunk_last_time};
+
+    IndexEntry entry = {recorder.chunk_first_time, recorder.chunk_last_time, recorder.offset,
+                        payload, recorder.chunk_count, magic == CHUNK_XOR_RLE_MAGIC};
+
+    // Data before index, so an index entry never points past the data
+    bool ok;
+    if (body == recorder.chunk.data() + sizeof(ChunkHeader)) {
+        memcpy(recorder.chunk.data(), &header, sizeof(header));
+        ok = recorder_write(recorder, recorder.chunk.data(), sizeof(header) + payload, recorder.offset);
+    } else {
+        ok = recorder_write(recorder, &header, sizeof(header), recorder.offset)
+          && recorder_write(recorder, body, payload, recorder.offset + sizeof(header));
+    }
+    if (!ok || !pwrite_all(recorder.index_fd, &entry, sizeof(entry), recorder.index_offset)) {
+        recorder.failed = true;
+        recorder.chunk_count = 0;
+        return false;
+    }
+
+    recorder.offset += sizeof(header) + payload;
+    recorder.index_offset += sizeof(entry);
+    recorder.chunks_written += 1;
+    recorder.chunk_count = 0;
+
+    if (recorder.live != nullptr) {
+        // With a DirectWriter the tail of the data may still be in flight
+        const uint64_t committed = recorder.direct != nullptr ? direct_writer_committed(*recorder.direct)
+                                                              : recorder.offset;
+        live_publish_progress(*recorder.live, committed, recorder.chunks_written);
+    }
+    return true;
+}
+
+/**
+ * @brief Appends one already-encoded record (RecordPrefix followed by the values)
+ * @param recorder The recorder to append to
+ * @param record Pointer to `record_size` bytes
+ * @return false if a chunk had to be written and the write failed, or an earlier one did
+ */
+inline bool recorder_append(Recorder &recorder, const void *record) {
+    if (recorder.failed)
+        return false;
+
+    RecordPrefix prefix;
+    memcpy(&prefix, record, sizeof(prefix));
+    if (recorder.chunk_count == 0)
+        recorder.chunk_first_time = prefix.time_ns;
+    recorder.chunk_last_time = prefix.time_ns;
+
+    uint8_t *dst = recorder.chunk.data() + sizeof(ChunkHeader)
+                 + static_cast<size_t>(recorder.chunk_count) * recorder.record_size;
+    memcpy(dst, record, recorder.record_size);
+    recorder.chunk_count += 1;
+
+    if (recorder.chunk_count == recorder.chunk_records)
+        return recorder_flush(recorder);
+    return true;
+}
+
+/**
+ * @brief Encodes and appends one telemetry sample
+ *
+ * The recorder must have been opened with Msg::axes values of Msg::value_type.
+ *
+ * @param recorder The recorder to append to
+ * @param sample The sample to record
+ * @return false if a chunk had to be written and the write failed, or an earlier one did
+ */
+template <typename Msg>
+bool recorder_append_sample(Recorder &recorder, const Sample<Msg> &sample) {
+    using T = typename Msg::value_type;
+    uint8_t record[sizeof(RecordPrefix) + Msg::axes * sizeof(T)];
+
+    RecordPrefix prefix = {sample.time_ns, sample.cycle, sample.decimation, sample.subsample};
+    memcpy(record, &prefix, sizeof(prefix));
+    memcpy(record + sizeof(prefix), sample.msg.arrayOfNumbers, Msg::axes * sizeof(T));
+    return recorder_append(recorder, record);
+}
+
+/**
+ * @brief Writes any pending records and closes the recording
+ * @param recorder The recorder to close
+ * @return true if the final chunk was written successfully
+ */
+inline bool recorder_close(Recorder &recorder) {
+    bool ok = recorder.fd >= 0 && recorder_flush(recorder);
+    if (recorder.map != nullptr) {
+        // Give back the preallocated space that was never used
+        munmap(recorder.map, recorder.map_size);
+        ok = ftruncate(recorder.fd, static_cast<off_t>(recorder.offset)) == 0 && ok;
+        recorder.map = nullptr;
+        recorder.map_size = 0;
+    }
+    if (recorder.direct != nullptr) {
+        ok = direct_writer_close(*recorder.direct) && ok;
+        recorder.direct = nullptr;
+        recorder.fd = -1;
+    }
+    if (recorder.live != nullptr) {
+        live_publish_progress(*recorder.live, recorder.offset, recorder.chunks_written);
+        recorder.live->closed.store(1, std::memory_order_release);
+    }
+    if (recorder.fd >= 0)
+        close(recorder.fd);
+    if (recorder.index_fd >= 0)
+        close(recorder.index_fd);
+    recorder.fd = recorder.index_fd = -1;
+    return ok;
+}
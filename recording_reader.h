@@ -0,0 +1,260 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "recorder.h"
+
+/**
+ * @brief Random-access reader for a recording written by Recorder.
+ *
+ * Opening a recording reads only the header and the time index; chunk data
+ * is mapped on demand with reader_map_chunk(), so seeking into a multi-GB
+ * recording touches only the pages of the chunks that are actually read.
+ * If the index file is missing or shorter than the data (e.g. after a crash)
+ * the chunk headers are walked once to rebuild it in memory.
+ */
+struct RecordingReader {
+    int fd = -1;
+    uint64_t file_size = 0;
+    RecordingHeader header = {};
+    std::vector<IndexEntry> index;
+};
+
+/**
+ * @brief A mapped view of one chunk's records.
+ *
+ * Uncompressed chunks are read straight from the mapping; compressed chunks
+ * are decoded into `decoded` and `records` points there.
+ */
+struct ChunkView {
+    const uint8_t *records = nullptr;
+    uint32_t count = 0;
+    uint32_t record_size = 0;
+
+    void *map = nullptr;
+    size_t map_len = 0;
+    std::vector<uint8_t> decoded;
+};
+
+/**
+ * @brief Whether an index entry describes a chunk that lies entirely within the first `file_size` bytes
+ *
+ * Uncompressed chunks must hold `count` whole records. Compressed ones may
+ * not claim more than the run-length code can expand to (128 bytes per input
+ * byte), so a corrupt count cannot force a huge allocation.
+ */
+inline bool chunk_entry_valid(const IndexEntry &entry, uint64_t file_size, uint32_t record_size) {
+    if (entry.count == 0 || entry.offset < sizeof(RecordingHeader) || entry.offset > file_size
+        || file_size - entry.offset < sizeof(ChunkHeader)
+        || entry.payload_bytes > file_size - entry.offset - sizeof(ChunkHeader))
+        return false;
+    const uint64_t raw_bytes = static_cast<uint64_t>(entry.count) * record_size;
+    return entry.compressed ? raw_bytes <= entry.payload_bytes * 128 : entry.payload_bytes >= raw_bytes;
+}
+
+/**
+ * @brief Whether an index entry describes a chunk that lies entirely inside the file
+ */
+inline bool reader_entry_valid(const RecordingReader &reader, const IndexEntry &entry) {
+    return chunk_entry_valid(entry, reader.file_size, reader.header.record_size);
+}
+
+/**
+ * @brief Walks the chunk headers after `offset` and appends their index entries
+ */
+inline void reader_scan_chunks(RecordingReader &reader, uint64_t offset) {
+    ChunkHeader chunk;
+    while (offset + sizeof(chunk) <= reader.file_size
+           && pread(reader.fd, &chunk, sizeof(chunk), static_cast<off_t>(offset)) == sizeof(chunk)
+           && (chunk.magic == CHUNK_MAGIC || chunk.magic == CHUNK_XOR_RLE_MAGIC)) {
+        const IndexEntry entry = {chunk.first_time_ns, chunk.last_time_ns, offset,
+                                  chunk.payload_bytes, chunk.count, chunk.magic == CHUNK_XOR_RLE_MAGIC};
+        if (!reader_entry_valid(reader, entry))
+            break;
+        reader.index.push_back(entry);
+        offset += sizeof(chunk) + chunk.payload_bytes;
+    }
+}
+
+/**
+ * @brief Opens a recording and loads its time index
+ * @param reader The reader to open
+ * @param path Path of the data file (the index is read from `<path>.idx`)
+ * @return true if the file is a recording this reader understands
+ */
+inline bool reader_open(RecordingReader &reader, const char *path) {
+    reader.fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (reader.fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(reader.fd, &st) != 0
+        || pread(reader.fd, &reader.header, sizeof(reader.header), 0) != sizeof(reader.header)
+        || reader.header.magic != RECORDING_MAGIC || reader.header.version != RECORDING_VERSION
+        || reader.header.record_size < sizeof(RecordPrefix)) {
+        close(reader.fd);
+        reader.fd = -1;
+        return false;
+    }
+    reader.file_size = static_cast<uint64_t>(st.st_size);
+
+    reader.index.clear();
+    const std::string index_path = std::string(path) + ".idx";
+    int index_fd = open(index_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (index_fd >= 0) {
+        IndexHeader index_header;
+        struct stat ist;
+        if (fstat(index_fd, &ist) == 0
+            && pread(index_fd, &index_header, sizeof(index_header), 0) == sizeof(index_header)
+            && index_header.magic == INDEX_MAGIC) {
+            const size_t n = (static_cast<size_t>(ist.st_size) - sizeof(index_header)) / sizeof(IndexEntry);
+            reader.index.resize(n);
+            const ssize_t want = static_cast<ssize_t>(n * sizeof(IndexEntry));
+            if (pread(index_fd, reader.index.data(), static_cast<size_t>(want), sizeof(index_header)) != want)
+                reader.index.clear();
+        }
+        close(index_fd);
+    }
+
+    // Keep the index up to its first bad entry (one pointing past truncated data,
+    // or the zero fill of a preallocated segment index), then pick up any unindexed chunks
+    for (size_t i = 0; i < reader.index.size(); ++i) {
+        if (!reader_entry_valid(reader, reader.index[i])) {
+            reader.index.resize(i);
+            break;
+        }
+    }
+    uint64_t next = sizeof(RecordingHeader);
+    if (!reader.index.empty())
+        next = reader.index.back().offset + sizeof(ChunkHeader) + reader.index.back().payload_bytes;
+    reader_scan_chunks(reader, next);
+    return true;
+}
+
+/**
+ * @brief Closes a recording
+ */
+inline void reader_close(RecordingReader &reader) {
+    if (reader.fd >= 0)
+        close(reader.fd);
+    reader.fd = -1;
+    reader.index.clear();
+}
+
+/**
+ * @brief Finds the first chunk that may contain records at or after `time_ns`
+ *
+ * Binary search over the index; assumes chunks were recorded in time order.
+ *
+ * @param reader The reader to search
+ * @param time_ns CLOCK_REALTIME time in nanoseconds
+ * @return Index of the chunk, or reader.index.size() if every record is earlier
+ */
+inline size_t reader_seek(const RecordingReader &reader, int64_t time_ns) {
+    size_t lo = 0;
+    size_t hi = reader.index.size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader.index[mid].last_time_ns < time_ns)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Maps one chunk of the recording read-only
+ * @param reader The reader to map from
+ * @param chunk Index of the chunk
+ * @param[out] view The mapped records; release it with reader_unmap_chunk()
+ * @return true if the chunk was mapped
+ */
+inline bool reader_map_chunk(const RecordingReader &reader, size_t chunk, ChunkView &view) {
+    if (chunk >= reader.index.size())
+        return false;
+
+    const IndexEntry &entry = reader.index[chunk];
+    const uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t start = entry.offset & ~(page - 1);
+    const uint64_t end = entry.offset + sizeof(ChunkHeader) + entry.payload_bytes;
+
+    void *map = mmap(nullptr, end - start, PROT_READ, MAP_SHARED, reader.fd, static_cast<off_t>(start));
+    if (map == MAP_FAILED)
+        return false;
+
+    view.map = map;
+    view.map_len = end - start;
+    view.records = static_cast<const uint8_t *>(map) + (entry.offset - start) + sizeof(ChunkHeader);
+    view.count = entry.count;
+    view.record_size = reader.header.record_size;
+
+    if (entry.compressed) {
+        const size_t raw_len = static_cast<size_t>(entry.count) * view.record_size;
+        view.decoded.resize(raw_len);
+        bool ok = chunk_decode(view.records, entry.payload_bytes, view.record_size, view.decoded.data(), raw_len);
+        munmap(view.map, view.map_len);
+        view.map = nullptr;
+        view.map_len = 0;
+        if (!ok)
+            return false;
+        view.records = view.decoded.data();
+    }
+    return true;
+}
+
+/**
+ * @brief Unmaps a chunk mapped with reader_map_chunk()
+ */
+inline void reader_unmap_chunk(ChunkView &view) {
+    if (view.map != nullptr)
+        munmap(view.map, view.map_len);
+    view.map = nullptr;
+    view.map_len = 0;
+    view.records = nullptr;
+    view.count = 0;
+}
+
+/**
+ * @brief Reads the prefix (time, cycle, ...) of record `i` of a chunk
+ */
+inline RecordPrefix chunk_record_prefix(const ChunkView &view, size_t i) {
+    RecordPrefix prefix;
+    memcpy(&prefix, view.records + i * view.record_size, sizeof(prefix));
+    return prefix;
+}
+
+/**
+ * @brief Pointer to the values of record `i` of a chunk
+ *
+ * The values are not necessarily aligned for their type; copy them out with
+ * memcpy.
+ */
+inline const uint8_t *chunk_record_values(const ChunkView &view, size_t i) {
+    return view.records + i * view.record_size + sizeof(RecordPrefix);
+}
+
+/**
+ * @brief Finds the first record at or after `time_ns` within a chunk
+ * @return Index of the record, or view.count if every record is earlier
+ */
+inline size_t chunk_lower_bound(const ChunkView &view, int64_t time_ns) {
+    size_t lo = 0;
+    size_t hi = view.count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (chunk_record_prefix(view, mid).time_ns < time_ns)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
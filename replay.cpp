@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "command_log.h"
+#include "recording_reader.h"
+#include "rt_logic.h"
+
+/*
+ * spsc_replay: re-executes the RT logic in virtual time against a command log.
+ *
+ * Every cycle up to the last recorded sample is run through rt_step() with
+ * the command that was in effect at that cycle according to the log, without
+ * sleeping. Each sample the recording holds is compared byte for byte with
+ * the one the re-execution produced for the same cycle and sub-sample; the
+ * first difference is reported. Timestamps are inputs, so recorded ones are
+ * fed back in.
+ */
+
+/**
+ * @brief Encodes a sample exactly like recorder_append_sample() does
+ */
+static void encode_sample(const Sample<Message> &sample, std::vector<uint8_t> &record) {
+    record.resize(sizeof(RecordPrefix) + sizeof(sample.msg.arrayOfNumbers));
+    RecordPrefix prefix = {sample.time_ns, sample.cycle, sample.decimation, sample.subsample};
+    memcpy(record.data(), &prefix, sizeof(prefix));
+    memcpy(record.data() + sizeof(prefix), sample.msg.arrayOfNumbers, sizeof(sample.msg.arrayOfNumbers));
+}
+
+/**
+ * @brief Prints the recorded and the replayed record side by side
+ */
+static void print_divergence(const uint8_t *recorded, const uint8_t *replayed) {
+    RecordPrefix a, b;
+    memcpy(&a, recorded, sizeof(a));
+    memcpy(&b, replayed, sizeof(b));
+    printf("  %-10s %24s %24s\n", "", "recorded", "replayed");
+    printf("  %-10s %24lld %24lld\n", "time_ns", static_cast<long long>(a.time_ns), static_cast<long long>(b.time_ns));
+    printf("  %-10s %24llu %24llu\n", "cycle", static_cast<unsigned long long>(a.cycle),
+           static_cast<unsigned long long>(b.cycle));
+    printf("  %-10s %24u %24u\n", "decimation", a.decimation, b.decimation);
+    printf("  %-10s %24u %24u\n", "subsample", a.subsample, b.subsample);
+    for (size_t axis = 0; axis < Message::axes; ++axis) {
+        float x, y;
+        memcpy(&x, recorded + sizeof(RecordPrefix) + axis * sizeof(float), sizeof(float));
+        memcpy(&y, replayed + sizeof(RecordPrefix) + axis * sizeof(float), sizeof(float));
+        printf("  %-10zu %24.9g %24.9g%s\n", axis, x, y, memcmp(&x, &y, sizeof(float)) != 0 ? "  <--" : "");
+    }
+}
+
+/**
+ * @brief Entry point of the replay tool
+ *
+ * Usage: spsc_replay COMMANDS RECORDING
+ */
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: spsc_replay COMMANDS RECORDING\n"
+                        "  COMMANDS and RECORDING are written by spsc_app --commands and --record\n");
+        return 2;
+    }
+
+    std::vector<CommandRecord<Message>> commands;
+    if (!command_log_load(argv[1], commands)) {
+        fprintf(stderr, "cannot read command log %s\n", argv[1]);
+        return 1;
+    }
+    RecordingReader reader;
+    if (!reader_open(reader, argv[2])) {
+        fprintf(stderr, "cannot open recording %s\n", argv[2]);
+        return 1;
+    }
+    if (reader.header.axes != Message::axes || reader.header.value_type != value_type_of<Message::value_type>()) {
+        fprintf(stderr, "%s was not recorded from Message samples\n", argv[2]);
+        return 1;
+    }
+
+    RtState state;
+    Telemetry tx;
+    Message command = {}; // what the mailbox holds before the first send_command
+    size_t next_command = 0;
+    bool running = true;
+    uint64_t events = 0;
+    uint64_t compared = 0;
+    std::vector<uint8_t> replayed;
+    std::vector<Sample<Message>> cycle_samples; // what the replay produced in its latest cycle
+
+    for (size_t c = 0; c < reader.index.size(); ++c) {
+        ChunkView view;
+        if (!reader_map_chunk(reader, c, view)) {
+            fprintf(stderr, "cannot read chunk %zu\n", c);
+            return 1;
+        }
+
+        for (size_t r = 0; r < view.count; ++r) {
+            const RecordPrefix prefix = chunk_record_prefix(view, r);
+            const uint8_t *recorded = view.records + r * view.record_size;
+
+            // Run the cycles up to this sample's; earlier samples may have been dropped in the bulk lane
+            const int64_t cycle_time_ns = prefix.time_ns - static_cast<int64_t>(prefix.subsample) * RT_SUBSAMPLE_NS;
+            while (running && state.cycle < prefix.cycle) {
+                const uint64_t cycle = state.cycle + 1;
+                while (next_command < commands.size() && commands[next_command].cycle <= cycle)
+                    command = commands[next_command++].command;
+
+                cycle_samples.clear();
+                running = rt_step(state, command, cycle == prefix.cycle ? cycle_time_ns : 0, tx);
+                telemetry_drain(tx,
+                    [&events](const TelemetryEvent &) { events += 1; },
+                    [&cycle_samples](const Sample<Message> &sample) { cycle_samples.push_back(sample); });
+            }
+
+            // The cycle's other sub-samples were produced along with it
+            bool produced = false;
+            for (const Sample<Message> &sample : cycle_samples) {
+                if (state.cycle == prefix.cycle && sample.cycle == prefix.cycle && sample.subsample == prefix.subsample) {
+                    encode_sample(sample, replayed);
+                    produced = true;
+                }
+            }
+            if (!produced) {
+                printf("first divergence at cycle %llu: the replay produced no sample for it (replay at cycle %llu%s)\n",
+                       static_cast<unsigned long long>(prefix.cycle), static_cast<unsigned long long>(state.cycle),
+                       running ? "" : ", stopped");
+                return 1;
+            }
+            if (replayed.size() != view.record_size || memcmp(replayed.data(), recorded, view.record_size) != 0) {
+                printf("first divergence at cycle %llu:\n", static_cast<unsigned long long>(prefix.cycle));
+                print_divergence(recorded, replayed.data());
+                return 1;
+            }
+            compared += 1;
+        }
+        reader_unmap_chunk(view);
+    }
+
+    printf("replayed %llu cycles against %zu commands: %llu samples identical, %llu events\n",
+           static_cast<unsigned long long>(state.cycle), commands.size(),
+           static_cast<unsigned long long>(compared), static_cast<unsigned long long>(events));
+    reader_close(reader);
+    return 0;
+}
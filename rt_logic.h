@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "spsc.h"
+#include "telemetry.h"
+
+// RT -> Observer channel: events on the critical lane, samples on the bulk lane
+using Telemetry = TelemetryChannel<Message>;
+
+// Period of the RT loop
+constexpr int64_t RT_PERIOD_NS = 20000000;
+
+// The sensor is read this many times per cycle; the readings are published together
+constexpr uint32_t RT_SUBSAMPLES = 4;
+constexpr int64_t RT_SUBSAMPLE_NS = RT_PERIOD_NS / RT_SUBSAMPLES;
+
+static_assert(RT_SUBSAMPLES * 4 <= Telemetry::bulk_capacity, "The bulk lane must hold a few cycles of sub-samples.");
+
+/**
+ * @brief Everything the RT logic carries from one cycle to the next.
+ */
+struct RtState {
+    uint64_t cycle = 0;
+    float last_command = 0.0f;
+    float last_output = 0.0f;
+};
+
+/**
+ * @brief One cycle of the RT logic, free of clocks, sleeps and mailboxes
+ *
+ * The command and the timestamp are inputs and all effects go to `tx`, so
+ * the same sequence of inputs always produces the same telemetry. The RT
+ * thread calls this once per period; spsc_replay calls it in virtual time
+ * against a command log.
+ *
+ * Each cycle produces RT_SUBSAMPLES oversampled readings, stamped
+ * RT_SUBSAMPLE_NS apart, which are staged and then published at once.
+ *
+ * @param state The state carried between cycles; `cycle` is advanced
+ * @param command The command in effect for this cycle
+ * @param time_ns Timestamp of this cycle's first sub-sample
+ * @param tx The telemetry channel to post events and samples into
+ * @return false once the command asks the RT thread to stop
+ */
+inline bool rt_step(RtState &state, const Message &command, int64_t time_ns, Telemetry &tx) {
+    state.cycle += 1;
+
+    telemetry_flush_events(tx);
+
+    if (!command.keepRunning) {
+        telemetry_post_event(tx, TelemetryEvent{state.cycle, EVENT_SHUTDOWN, 0.0f});
+        return false;
+    }
+
+    if (command.arrayOfNumbers[0] != state.last_command) {
+        state.last_command = command.arrayOfNumbers[0];
+        telemetry_post_event(tx, TelemetryEvent{state.cycle, EVENT_STATE_CHANGE, state.last_command});
+    }
+
+    size_t staged = 0;
+    for (uint32_t k = 0; k < RT_SUBSAMPLES; ++k) {
+        Sample<Message> sample{};
+        sample.cycle = state.cycle;
+        sample.subsample = k;
+        sample.time_ns = time_ns + static_cast<int64_t>(k) * RT_SUBSAMPLE_NS;
+        sample.msg.keepRunning = true;
+        sample.msg.arrayOfNumbers[0] = command.arrayOfNumbers[0] + static_cast<float>(state.cycle)
+                                     + static_cast<float>(k) / RT_SUBSAMPLES;
+        telemetry_stage_sample(tx, sample, staged);
+        state.last_output = sample.msg.arrayOfNumbers[0];
+    }
+    telemetry_publish_samples(tx, staged);
+    return true;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+/**
+ * @brief How an RT thread is placed and scheduled.
+ *
+ * The defaults leave the thread as an ordinary, unpinned SCHED_OTHER thread,
+ * so nothing needs privileges unless asked for.
+ */
+struct RtThreadConfig {
+    int cpu = -1;             // pin to this CPU; -1: no pinning
+    int priority = 0;         // SCHED_FIFO priority 1..99; 0: keep SCHED_OTHER
+    bool lock_memory = false; // mlockall() so page faults cannot stall the loop
+};
+
+/**
+ * @brief Applies a configuration to the calling thread
+ *
+ * Every step is attempted; a step that fails (typically EPERM without
+ * CAP_SYS_NICE / CAP_IPC_LOCK) is reported on stderr and the rest still runs.
+ *
+ * @param config The configuration to apply
+ * @return true if every requested step succeeded
+ */
+inline bool rt_thread_configure(const RtThreadConfig &config) {
+    bool ok = true;
+    if (config.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(config.cpu, &set);
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            fprintf(stderr, "rt_thread: cannot pin to CPU %d: %s\n", config.cpu, strerror(err));
+            ok = false;
+        }
+    }
+    if (config.priority > 0) {
+        struct sched_param param = {};
+        param.sched_priority = config.priority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err != 0) {
+            fprintf(stderr, "rt_thread: cannot set SCHED_FIFO %d: %s\n", config.priority, strerror(err));
+            ok = false;
+        }
+    }
+    if (config.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        fprintf(stderr, "rt_thread: mlockall failed: %s\n", strerror(errno));
+        ok = false;
+    }
+    return ok;
+}
+
+/**
+ * @brief Starts a thread that applies `config` to itself and then runs `fn(args...)`
+ *
+ * Configuring from inside the new thread means the caller never has to know
+ * its native handle, and the loop only starts once placement is settled.
+ */
+template <typename Fn, typename... Args>
+std::thread rt_thread_launch(const RtThreadConfig &config, Fn &&fn, Args &&...args) {
+    return std::thread(
+        [config](auto &&f, auto &&...a) {
+            rt_thread_configure(config);
+            f(std::forward<decltype(a)>(a)...);
+        },
+        std::forward<Fn>(fn), std::forward<Args>(args)...);
+}
+
+/**
+ * @brief How a PeriodicTimer waits for its next deadline.
+ */
+enum class TimerMode {
+    SleepUntil,     // std::this_thread::sleep_until on steady_clock
+    ClockNanosleep, // clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME)
+    HybridSpin,     // clock_nanosleep until `spin_ns` before the deadline, then busy-wait
+};
+
+/**
+ * @brief A fixed-rate timer with absolute deadlines, so wake-up errors never accumulate.
+ */
+struct PeriodicTimer {
+    TimerMode mode = TimerMode::ClockNanosleep;
+    int64_t period_ns = 0;
+    int64_t spin_ns = 0;
+    int64_t next_ns = 0; // CLOCK_MONOTONIC deadline of the next wake-up
+};
+
+/**
+ * @brief Current CLOCK_MONOTONIC time in nanoseconds
+ */
+inline int64_t monotonic_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Sleeps until an absolute CLOCK_MONOTONIC time, resuming after signals
+ */
+inline void sleep_until_monotonic_ns(int64_t deadline_ns) {
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(deadline_ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(deadline_ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+/**
+ * @brief Starts a timer whose first deadline is one period from now
+ * @param timer The timer to start
+ * @param period_ns The period in nanoseconds
+ * @param mode How to wait
+ * @param spin_ns For HybridSpin: how long before the deadline to start spinning
+ */
+inline void timer_start(PeriodicTimer &timer, int64_t period_ns, TimerMode mode = TimerMode::ClockNanosleep,
+                        int64_t spin_ns = 50000) {
+    timer.mode = mode;
+    timer.period_ns = period_ns;
+    timer.spin_ns = spin_ns;
+    timer.next_ns = monotonic_now_ns() + period_ns;
+}
+
+/**
+ * @brief Waits for the next deadline and schedules the one after it
+ *
+ * steady_clock is CLOCK_MONOTONIC on Linux, so all modes share one time base.
+ *
+ * @param timer The timer to wait on
+ * @return Wake-up latency: how many nanoseconds after the deadline the call returned
+ */
+inline int64_t timer_wait(PeriodicTimer &timer) {
+    const int64_t deadline = timer.next_ns;
+    switch (timer.mode) {
+    case TimerMode::SleepUntil:
+        std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline)));
+        break;
+    case TimerMode::ClockNanosleep:
+        sleep_until_monotonic_ns(deadline);
+        break;
+    case TimerMode::HybridSpin:
+        sleep_until_monotonic_ns(deadline - timer.spin_ns);
+        while (monotonic_now_ns() < deadline) {
+        }
+        break;
+    }
+    const int64_t latency = monotonic_now_ns() - deadline;
+    timer.next_ns += timer.period_ns;
+    return latency;
+}
+
+/**
+ * @brief Name of a timer mode, as accepted by timer_mode_from_name()
+ */
+inline const char *timer_mode_name(TimerMode mode) {
+    switch (mode) {
+    case TimerMode::SleepUntil:
+        return "sleep_until";
+    case TimerMode::ClockNanosleep:
+        return "nanosleep";
+    case TimerMode::HybridSpin:
+        return "hybrid";
+    }
+    return "?";
+}
+
+/**
+ * @brief Parses a timer mode name
+ * @return false if the name is unknown
+ */
+inline bool timer_mode_from_name(const char *name, TimerMode &mode) {
+    for (TimerMode m : {TimerMode::SleepUntil, TimerMode::ClockNanosleep, TimerMode::HybridSpin}) {
+        if (strcmp(name, timer_mode_name(m)) == 0) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,367 @@
+#pragma once
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "recorder.h"
+
+/**
+ * @brief One recording segment's files, as prepared ahead of time or handed back for finishing.
+ */
+struct SegmentFiles {
+    std::string path;
+    int fd = -1;
+    int index_fd = -1;
+    uint8_t *map = nullptr;
+    uint64_t map_size = 0;
+    uint64_t used = 0;       // data bytes written
+    uint64_t index_used = 0; // index bytes written
+};
+
+inline void segment_finish(SegmentFiles &segment);
+
+/**
+ * @brief Creates a segment, preallocates `size` bytes and maps it with the pages populated
+ *
+ * This does all the filesystem metadata work and page faulting for a segment
+ * so that writing into it later is a plain memcpy. The index is preallocated
+ * at its final size too, so appending entries never changes its i_size; the
+ * reader stops at the first all-zero entry. On failure nothing is left behind.
+ *
+ * @param segment Filled in with the open files and the mapping
+ * @param path Path of the data file; the index goes to `<path>.idx`
+ * @param size Size to preallocate and map
+ * @return true if the segment is ready to be written
+ */
+inline bool segment_prepare(SegmentFiles &segment, const std::string &path, uint64_t size) {
+    const std::string index_path = path + ".idx";
+    segment.path = path;
+    segment.map = nullptr;
+    segment.used = segment.index_used = 0;
+    segment.fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    segment.index_fd = open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    // Allocate the blocks now; fall back to a sparse file where fallocate is unsupported.
+    // The index is sized for one chunk per 4 KiB of data and only grows past that if chunks are smaller.
+    const uint64_t index_size = sizeof(IndexHeader) + (size / 4096 + 1) * sizeof(IndexEntry);
+    bool ok = segment.fd >= 0 && segment.index_fd >= 0
+           && (fallocate(segment.fd, 0, 0, static_cast<off_t>(size)) == 0
+               || ftruncate(segment.fd, static_cast<off_t>(size)) == 0)
+           && (fallocate(segment.index_fd, 0, 0, static_cast<off_t>(index_size)) == 0
+               || ftruncate(segment.index_fd, static_cast<off_t>(index_size)) == 0);
+
+    void *map = ok ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, segment.fd, 0)
+                   : MAP_FAILED;
+    if (map == MAP_FAILED) {
+        segment_finish(segment);
+        unlink(path.c_str());
+        unlink(index_path.c_str());
+        return false;
+    }
+    segment.map = static_cast<uint8_t *>(map);
+    segment.map_size = size;
+    return true;
+}
+
+/**
+ * @brief Unmaps a segment, trims it and its index to the bytes actually used and closes them
+ * @param segment The segment to finish
+ */
+inline void segment_finish(SegmentFiles &segment) {
+    if (segment.map != nullptr)
+        munmap(segment.map, segment.map_size);
+    if (segment.fd >= 0) {
+        if (ftruncate(segment.fd, static_cast<off_t>(segment.used)) != 0)
+            perror("segment_finish: ftruncate");
+        close(segment.fd);
+    }
+    if (segment.index_fd >= 0) {
+        if (ftruncate(segment.index_fd, static_cast<off_t>(segment.index_used)) != 0)
+            perror("segment_finish: ftruncate index");
+        close(segment.index_fd);
+    }
+    segment.map = nullptr;
+    segment.fd = segment.index_fd = -1;
+}
+
+/**
+ * @brief Recorder that rotates through preallocated, pre-mapped segments.
+ *
+ * A new segment `<base>.NNNNNN.rec` is started when the current one would
+ * exceed `segment_bytes` or once it spans `segment_ns` of recorded time. A
+ * background thread always keeps the next segment created, fallocate'd and
+ * mapped before it is needed, finishes retired segments (unmap, trim, close)
+ * and deletes the oldest finished segments beyond `keep_segments`, so the
+ * drain thread never does filesystem metadata work at a segment boundary.
+ * `stalls` counts rotations that had to wait for the next segment anyway.
+ *
+ * A failed background prepare (e.g. a transient ENOSPC or EMFILE) is retried
+ * synchronously at the rotation, as a stall, and counted in
+ * `prepare_failures`. If that fails too, recording stays in the current
+ * segment and the next rotation tries again. Records that only needed a
+ * time-based rotation are still kept; records that no longer fit are dropped.
+ * Set `current.live` before opening to let viewers follow across segments.
+ */
+struct SegmentedRecorder {
+    // Configuration
+    std::string base;
+    uint64_t segment_bytes = 0;
+    int64_t segment_ns = 0;   // 0: rotate by size only
+    size_t keep_segments = 0; // 0: keep everything
+    uint32_t axes = 0;
+    uint32_t value_type = VALUE_F32;
+    uint32_t chunk_records = 0;
+    bool compress = false;
+
+    // Drain-thread state
+    Recorder current;
+    std::string current_path;
+    uint64_t sequence = 0;
+    int64_t segment_start_ns = 0;
+    bool segment_has_records = false;
+    uint64_t stalls = 0;
+    uint64_t prepare_failures = 0;
+
+    // Shared with the background thread
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stop = false;
+    bool prepare_requested = false;
+    bool prepared_ready = false;
+    bool prepare_failed = false;
+    SegmentFiles prepared;
+    std::deque<SegmentFiles> to_finish;
+    std::deque<std::string> finished;
+};
+
+/**
+ * @brief Path of segment number `sequence`
+ */
+inline std::string segment_path(const SegmentedRecorder &recorder, uint64_t sequence) {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), ".%06llu.rec", static_cast<unsigned long long>(sequence));
+    return recorder.base + suffix;
+}
+
+/**
+ * @brief Background thread: prepares the next segment, finishes old ones, applies retention
+ */
+inline void segment_worker(SegmentedRecorder &recorder) {
+    std::unique_lock<std::mutex> guard(recorder.lock);
+    while (true) {
+        recorder.wake.wait(guard, [&] {
+            return recorder.stop || recorder.prepare_requested || !recorder.to_finish.empty();
+        });
+
+        if (recorder.prepare_requested) {
+            recorder.prepare_requested = false;
+            const std::string path = segment_path(recorder, recorder.sequence + 1);
+            guard.unlock();
+            SegmentFiles next;
+            bool ok = segment_prepare(next, path, recorder.segment_bytes);
+            guard.lock();
+            recorder.prepared = next;
+            recorder.prepared_ready = ok;
+            recorder.prepare_failed = !ok;
+            recorder.wake.notify_all();
+            continue;
+        }
+
+        if (!recorder.to_finish.empty()) {
+            SegmentFiles old = recorder.to_finish.front();
+            recorder.to_finish.pop_front();
+            guard.unlock();
+            segment_finish(old);
+            guard.lock();
+
+            recorder.finished.push_back(old.path);
+            while (recorder.keep_segments > 0 && recorder.finished.size() > recorder.keep_segments) {
+                const std::string victim = recorder.finished.front();
+                recorder.finished.pop_front();
+                guard.unlock();
+                unlink(victim.c_str());
+                unlink((victim + ".idx").c_str());
+                guard.lock();
+            }
+            continue;
+        }
+
+        if (recorder.stop)
+            return;
+    }
+}
+
+/**
+ * @brief Starts recording into the first segment and launches the background thread
+ *
+ * Set the configuration fields (base, segment_bytes, segment_ns,
+ * keep_segments, axes, value_type, chunk_records, compress) first.
+ *
+ * @param recorder The recorder to open
+ * @return true if the first segment was created
+ */
+inline bool segmented_open(SegmentedRecorder &recorder) {
+    const uint64_t max_chunk = sizeof(ChunkHeader) + static_cast<uint64_t>(recorder.chunk_records)
+                             * (sizeof(RecordPrefix) + recorder.axes * value_type_size(recorder.value_type));
+    if (recorder.segment_bytes < sizeof(RecordingHeader) + max_chunk)
+        return false;
+
+    SegmentFiles first;
+    recorder.sequence = 0;
+    recorder.current_path = segment_path(recorder, 0);
+    if (!segment_prepare(first, recorder.current_path, recorder.segment_bytes)
+        || !recorder_begin(recorder.current, first.fd, first.index_fd, first.map, first.map_size,
+                           recorder.axes, recorder.value_type, recorder.chunk_records, recorder.compress,
+                           recorder.current_path.c_str())) {
+        segment_finish(first);
+        return false;
+    }
+
+    recorder.stop = false;
+    recorder.prepare_requested = true;
+    recorder.worker = std::thread(segment_worker, std::ref(recorder));
+    return true;
+}
+
+/**
+ * @brief Hands the current segment to the background thread and switches to the prepared one
+ * @return true if recording continues in a new segment
+ */
+inline bool segmented_rotate(SegmentedRecorder &recorder) {
+    if (!recorder_flush(recorder.current))
+        return false;
+
+    Recorder &cur = recorder.current;
+    SegmentFiles old = {recorder.current_path, cur.fd,     cur.index_fd,     cur.map,
+                        cur.map_size,          cur.offset, cur.index_offset};
+
+    std::unique_lock<std::mutex> guard(recorder.lock);
+    if (!recorder.prepared_ready && !recorder.prepare_failed) {
+        recorder.stalls += 1;
+        recorder.wake.wait(guard, [&] { return recorder.prepared_ready || recorder.prepare_failed; });
+    }
+
+    SegmentFiles next;
+    bool have_next = recorder.prepared_ready;
+    if (have_next) {
+        next = recorder.prepared;
+        recorder.prepared_ready = false;
+    } else {
+        // The background prepare failed; it may have been transient, so try once more here
+        recorder.prepare_failed = false;
+        recorder.prepare_failures += 1;
+        recorder.stalls += 1;
+        const std::string path = segment_path(recorder, recorder.sequence + 1);
+        guard.unlock();
+        have_next = segment_prepare(next, path, recorder.segment_bytes);
+        guard.lock();
+    }
+    if (!have_next) {
+        // Stay in the current segment and have the background thread try again
+        recorder.prepare_requested = true;
+        recorder.wake.notify_all();
+        return false;
+    }
+
+    recorder.to_finish.push_back(old);
+    recorder.sequence += 1;
+    recorder.prepare_requested = true;
+    recorder.wake.notify_all();
+    guard.unlock();
+
+    recorder.current_path = next.path;
+    recorder.segment_has_records = false;
+    return recorder_begin(recorder.current, next.fd, next.index_fd, next.map, next.map_size,
+                          recorder.axes, recorder.value_type, recorder.chunk_records, recorder.compress,
+                          recorder.current_path.c_str());
+}
+
+/**
+ * @brief Appends one encoded record, rotating to the next segment when due
+ * @param recorder The recorder to append to
+ * @param record Pointer to `record_size` bytes (RecordPrefix followed by the values)
+ * @return true unless a write or rotation failed
+ */
+inline bool segmented_append(SegmentedRecorder &recorder, const void *record) {
+    RecordPrefix prefix;
+    memcpy(&prefix, record, sizeof(prefix));
+
+    Recorder &cur = recorder.current;
+    const uint64_t max_chunk = sizeof(ChunkHeader) + static_cast<uint64_t>(cur.chunk_records) * cur.record_size;
+    const bool full = cur.chunk_count == 0 && cur.offset + max_chunk > recorder.segment_bytes;
+    const bool expired = recorder.segment_ns > 0 && recorder.segment_has_records
+                      && prefix.time_ns - recorder.segment_start_ns >= recorder.segment_ns;
+    if ((full || expired) && !segmented_rotate(recorder) && full)
+        return false;
+
+    if (!recorder.segment_has_records) {
+        recorder.segment_start_ns = prefix.time_ns;
+        recorder.segment_has_records = true;
+    }
+    return recorder_append(recorder.current, record);
+}
+
+/**
+ * @brief Encodes and appends one telemetry sample
+ * @param recorder The recorder to append to
+ * @param sample The sample to record
+ * @return true unless a write or rotation failed
+ */
+template <typename Msg>
+bool segmented_append_sample(SegmentedRecorder &recorder, const Sample<Msg> &sample) {
+    using T = typename Msg::value_type;
+    uint8_t record[sizeof(RecordPrefix) + Msg::axes * sizeof(T)];
+
+    RecordPrefix prefix = {sample.time_ns, sample.cycle, sample.decimation, sample.subsample};
+    memcpy(record, &prefix, sizeof(prefix));
+    memcpy(record + sizeof(prefix), sample.msg.arrayOfNumbers, Msg::axes * sizeof(T));
+    return segmented_append(recorder, record);
+}
+
+/**
+ * @brief Flushes and finishes the current segment, stops the background thread
+ *
+ * The segment that was prepared but never used is deleted.
+ *
+ * @param recorder The recorder to close
+ * @return true if the final chunk was written
+ */
+inline bool segmented_close(SegmentedRecorder &recorder) {
+    bool ok = recorder.current.fd >= 0 && recorder_flush(recorder.current);
+    Recorder &cur = recorder.current;
+    SegmentFiles last = {recorder.current_path, cur.fd,     cur.index_fd,     cur.map,
+                         cur.map_size,          cur.offset, cur.index_offset};
+
+    {
+        std::unique_lock<std::mutex> guard(recorder.lock);
+        if (cur.fd >= 0)
+            recorder.to_finish.push_back(last);
+        recorder.prepare_requested = false;
+        recorder.stop = true;
+        recorder.wake.notify_all();
+    }
+    if (recorder.worker.joinable())
+        recorder.worker.join();
+
+    if (recorder.prepared_ready || recorder.prepare_failed) {
+        segment_finish(recorder.prepared);
+        unlink(recorder.prepared.path.c_str());
+        unlink((recorder.prepared.path + ".idx").c_str());
+        recorder.prepared_ready = recorder.prepare_failed = false;
+    }
+    if (cur.live != nullptr)
+        cur.live->closed.store(1, std::memory_order_release);
+    cur.fd = cur.index_fd = -1;
+    cur.map = nullptr;
+    return ok;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Checks whether any |a[i] - b[i]| is larger than limit[i]
+ *
+ * An element that is NaN on exactly one side counts as exceeding its limit;
+ * NaN on both sides does not. The float version compares four lanes at a time with SSE2 when it is
+ * available; everything else falls back to a scalar loop.
+ *
+ * @param a First array of values
+ * @param b Second array of values
+ * @param limit Per-element threshold
+ * @param n Number of elements
+ * @return true if at least one element differs by more than its threshold
+ */
+template <typename T>
+bool any_abs_diff_exceeds(const T *a, const T *b, const T *limit, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        T d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+        if (d > limit[i] || (a[i] != a[i]) != (b[i] != b[i]))
+            return true;
+    }
+    return false;
+}
+
+#if defined(__SSE2__)
+template <>
+inline bool any_abs_diff_exceeds<float>(const float *a, const float *b, const float *limit, size_t n) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128 va = _mm_loadu_ps(a + i);
+        const __m128 vb = _mm_loadu_ps(b + i);
+        const __m128 d = _mm_andnot_ps(sign, _mm_sub_ps(va, vb));
+        const __m128 nan_changed = _mm_xor_ps(_mm_cmpunord_ps(va, va), _mm_cmpunord_ps(vb, vb));
+        if (_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(d, _mm_loadu_ps(limit + i)), nan_changed)) != 0)
+            return true;
+    }
+    for (; i < n; ++i) {
+        if (fabsf(a[i] - b[i]) > limit[i] || isnan(a[i]) != isnan(b[i]))
+            return true;
+    }
+    return false;
+}
+#endif
+
+/**
+ * @brief Minimum, maximum and sum of a column of values
+ *
+ * Uses two-lane SSE2 min/max/add when available. `min`, `max` and `sum` are
+ * updated in place, so a column can be processed in pieces.
+ *
+ * @param values The column
+ * @param n Number of values
+ * @param[in,out] min Running minimum
+ * @param[in,out] max Running maximum
+ * @param[in,out] sum Running sum
+ */
+inline void column_min_max_sum(const double *values, size_t n, double &min, double &max, double &sum) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    if (n >= 2) {
+        __m128d vmin = _mm_set1_pd(min);
+        __m128d vmax = _mm_set1_pd(max);
+        __m128d vsum = _mm_setzero_pd();
+        for (; i + 2 <= n; i += 2) {
+            __m128d v = _mm_loadu_pd(values + i);
+            vmin = _mm_min_pd(vmin, v);
+            vmax = _mm_max_pd(vmax, v);
+            vsum = _mm_add_pd(vsum, v);
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, vmin);
+        min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+        _mm_storeu_pd(lanes, vmax);
+        max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+        _mm_storeu_pd(lanes, vsum);
+        sum += lanes[0] + lanes[1];
+    }
+#endif
+    for (; i < n; ++i) {
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+        sum += values[i];
+    }
+}
+
+/**
+ * @brief Counts upward crossings of a threshold (value goes from <= to > threshold)
+ * @param values The column
+ * @param n Number of values
+ * @param threshold The level to count crossings of
+ * @return Number of i with values[i - 1] <= threshold < values[i]
+ */
+inline size_t column_crossings(const double *values, size_t n, double threshold) {
+    size_t count = 0;
+    for (size_t i = 1; i < n; ++i)
+        count += (values[i - 1] <= threshold) & (values[i] > threshold);
+    return count;
+}
+
+/*
+ * Log-bucket keys
+ *
+ * A cheap, monotonic stand-in for log2: for x = (1 + f) * 2^e it returns
+ * e + f, read straight from the exponent and mantissa bits. Bucket `k` holds
+ * the positive values with floor(log2_approx(x) * multiplier) == k. Since the
+ * approximation never grows slower than the natural log, a bucket is at most
+ * 1 / multiplier wide in log space. The bias keeps the truncating
+ * conversion equal to floor() and is applied the same way on every path, so
+ * the scalar and vector versions always agree.
+ */
+
+constexpr double LOG_BUCKET_BIAS = 1 << 24;
+
+/**
+ * @brief Log bucket of a positive, normal value
+ */
+inline int32_t log_bucket_key(double x, double multiplier) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    const double e = static_cast<double>(static_cast<int64_t>(bits >> 52) - 1023);
+    const double f = static_cast<double>(bits & ((uint64_t(1) << 52) - 1)) * 0x1p-52;
+    return static_cast<int32_t>((e + f) * multiplier + LOG_BUCKET_BIAS) - static_cast<int32_t>(LOG_BUCKET_BIAS);
+}
+
+/**
+ * @brief Smallest value that falls into log bucket `key`
+ */
+inline double log_bucket_lower(int32_t key, double multiplier) {
+    const double l = static_cast<double>(key) / multiplier;
+    const double e = floor(l);
+    return ldexp(1.0 + (l - e), static_cast<int>(e));
+}
+
+/**
+ * @brief Log buckets of the absolute values of a column of floats
+ *
+ * Converts four values at a time with SSE2 when it is available. Results for
+ * zero, subnormal or non-finite values are meaningless; callers filter those.
+ *
+ * @param values The column
+ * @param n Number of values
+ * @param multiplier Buckets per unit of log2
+ * @param[out] keys One key per value
+ */
+inline void log_bucket_keys(const float *values, size_t n, double multiplier, int32_t *keys) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i abs_mask = _mm_set1_epi32(0x7fffffff);
+    const __m128i mantissa_mask = _mm_set1_epi32(0x7fffff);
+    const __m128i exponent_bias = _mm_set1_epi32(127);
+    const __m128d scale = _mm_set1_pd(0x1p-23);
+    const __m128d mult = _mm_set1_pd(multiplier);
+    const __m128d bias = _mm_set1_pd(LOG_BUCKET_BIAS);
+    const __m128i ibias = _mm_set1_epi32(static_cast<int32_t>(LOG_BUCKET_BIAS));
+    for (; i + 4 <= n; i += 4) {
+        __m128i bits = _mm_and_si128(_mm_castps_si128(_mm_loadu_ps(values + i)), abs_mask);
+        __m128i e = _mm_sub_epi32(_mm_srli_epi32(bits, 23), exponent_bias);
+        __m128i m = _mm_and_si128(bits, mantissa_mask);
+
+        // Two lanes at a time in double precision, exactly like log_bucket_key()
+        __m128d lo = _mm_add_pd(_mm_cvtepi32_pd(e), _mm_mul_pd(_mm_cvtepi32_pd(m), scale));
+        __m128d hi = _mm_add_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(e, 0xee)),
+                                _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(m, 0xee)), scale));
+        __m128i klo = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(lo, mult), bias));
+        __m128i khi = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(hi, mult), bias));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + i), _mm_sub_epi32(_mm_unpacklo_epi64(klo, khi), ibias));
+    }
+#endif
+    for (; i < n; ++i)
+        keys[i] = log_bucket_key(fabs(static_cast<double>(values[i])), multiplier);
+}
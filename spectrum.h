@@ -0,0 +1,285 @@
+#pragma once
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+/**
+ * @brief Precomputed tables for a real FFT of N points.
+ *
+ * The N real inputs are packed into N/2 complex values, transformed with an
+ * iterative radix-2 FFT and then split into the N/2 + 1 bins of the real
+ * spectrum. All twiddles, the bit-reversal permutation and the analysis
+ * window are computed once by fft_plan_init().
+ */
+template <size_t N>
+struct FftPlan {
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two >= 4.");
+    static constexpr size_t half = N / 2;
+
+    uint32_t bitrev[half];
+    float twiddle_re[half / 2]; // exp(-2 pi i k / (N/2))
+    float twiddle_im[half / 2];
+    float split_re[half];       // exp(-2 pi i k / N)
+    float split_im[half];
+    float window[N];            // Hann
+
+    // Scratch for one transform
+    float re[half];
+    float im[half];
+};
+
+/**
+ * @brief Fills in the tables of an FFT plan
+ */
+template <size_t N>
+void fft_plan_init(FftPlan<N> &plan) {
+    constexpr size_t half = N / 2;
+    const double pi = 3.14159265358979323846;
+
+    size_t bits = 0;
+    while ((size_t(1) << bits) < half)
+        ++bits;
+    for (size_t i = 0; i < half; ++i) {
+        uint32_t r = 0;
+        for (size_t b = 0; b < bits; ++b)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        plan.bitrev[i] = r;
+    }
+    for (size_t k = 0; k < half / 2; ++k) {
+        plan.twiddle_re[k] = static_cast<float>(cos(2.0 * pi * k / half));
+        plan.twiddle_im[k] = static_cast<float>(-sin(2.0 * pi * k / half));
+    }
+    for (size_t k = 0; k < half; ++k) {
+        plan.split_re[k] = static_cast<float>(cos(2.0 * pi * k / N));
+        plan.split_im[k] = static_cast<float>(-sin(2.0 * pi * k / N));
+    }
+    for (size_t n = 0; n < N; ++n)
+        plan.window[n] = static_cast<float>(0.5 - 0.5 * cos(2.0 * pi * n / N));
+}
+
+/**
+ * @brief Power spectrum of N windowed real samples
+ *
+ * @param plan The plan for this size
+ * @param input N samples, oldest first
+ * @param[out] power N/2 + 1 bins of |X[k]|^2, from DC to Nyquist
+ */
+template <size_t N>
+void fft_real_power(FftPlan<N> &plan, const float *input, float *power) {
+    constexpr size_t half = N / 2;
+    float *re = plan.re;
+    float *im = plan.im;
+
+    // Window and pack even/odd samples as real/imaginary parts, in bit-reversed order
+    for (size_t n = 0; n < half; ++n) {
+        const uint32_t j = plan.bitrev[n];
+        re[j] = input[2 * n] * plan.window[2 * n];
+        im[j] = input[2 * n + 1] * plan.window[2 * n + 1];
+    }
+
+    // Iterative radix-2 butterflies over the N/2 complex points
+    for (size_t len = 2; len <= half; len <<= 1) {
+        const size_t step = half / len;
+        for (size_t start = 0; start < half; start += len) {
+            for (size_t k = 0; k < len / 2; ++k) {
+                const float wr = plan.twiddle_re[k * step];
+                const float wi = plan.twiddle_im[k * step];
+                const size_t a = start + k;
+                const size_t b = a + len / 2;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+
+    // Split the packed transform into the spectrum of the real input
+    power[0] = (re[0] + im[0]) * (re[0] + im[0]);
+    power[half] = (re[0] - im[0]) * (re[0] - im[0]);
+    for (size_t k = 1; k < half; ++k) {
+        const float zr = re[k], zi = im[k];
+        const float cr = re[half - k], ci = -im[half - k]; // conj(Z[N/2 - k])
+        const float er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+        const float or_ = 0.5f * (zi - ci), oi = -0.5f * (zr - cr); // (Z - conj) / 2i
+        const float xr = er + plan.split_re[k] * or_ - plan.split_im[k] * oi;
+        const float xi = ei + plan.split_re[k] * oi + plan.split_im[k] * or_;
+        power[k] = xr * xr + xi * xi;
+    }
+}
+
+/**
+ * @brief Sliding-window spectra of every telemetry field (Observer side).
+ *
+ * The newest N samples of each field are kept in a circular history. Every
+ * `Hop` samples a new frame is transformed for all fields, so consecutive
+ * frames overlap by N - Hop samples, and its power spectrum is folded into
+ * an exponential average (`smoothing` is the weight of the new frame).
+ * Frames are mean-removed and Hann-windowed before the transform.
+ * Spectral peaks, e.g. from cable vibration, can then be read off `power`.
+ *
+ * The FFT assumes evenly spaced samples, so the history only ever holds an
+ * unbroken run: `subsamples` readings per cycle, one cycle every
+ * `decimation`. A sample that does not directly follow the previous one
+ * (dropped samples, a cycle gap) restarts the history; one with another
+ * decimation also discards the averaged spectrum, whose bins belonged to
+ * the old sample rate. `resets` counts both.
+ */
+template <size_t Axes, size_t N = 256, size_t Hop = N / 2>
+struct SpectrumAnalyzer {
+    static_assert(Hop > 0 && Hop <= N, "Hop must be between 1 and N.");
+    static constexpr size_t bins = N / 2 + 1;
+
+    FftPlan<N> plan;
+    float smoothing = 0.25f;
+
+    float history[Axes][N];
+    size_t written = 0;        // total samples pushed
+    size_t since_frame = 0;    // samples pushed since the last frame
+
+    float power[Axes][bins];
+    uint64_t frames = 0;
+
+    // Position of the newest sample, to tell a continuation from a gap
+    uint32_t subsamples = 1;   // samples per cycle
+    uint32_t decimation = 0;   // of the samples in the history; 0 before the first
+    uint64_t last_cycle = 0;
+    uint32_t last_subsample = 0;
+    uint64_t resets = 0;
+};
+
+/**
+ * @brief Prepares an analyzer
+ * @param analyzer The analyzer to initialize
+ * @param smoothing Weight of each new frame in the averaged spectrum (1: no averaging)
+ * @param subsamples Samples per RT cycle, numbered by Sample::subsample
+ */
+template <size_t Axes, size_t N, size_t Hop>
+void spectrum_init(SpectrumAnalyzer<Axes, N, Hop> &analyzer, float smoothing = 0.25f, uint32_t subsamples = 1) {
+    fft_plan_init(analyzer.plan);
+    analyzer.smoothing = smoothing;
+    memset(analyzer.history, 0, sizeof(analyzer.history));
+    memset(analyzer.power, 0, sizeof(analyzer.power));
+    analyzer.written = 0;
+    analyzer.since_frame = 0;
+    analyzer.frames = 0;
+    analyzer.subsamples = subsamples > 0 ? subsamples : 1;
+    analyzer.decimation = 0;
+    analyzer.last_cycle = 0;
+    analyzer.last_subsample = 0;
+    analyzer.resets = 0;
+}
+
+/**
+ * @brief Whether a sample is the one directly after the newest in the history, at the same rate
+ */
+template <typename Msg, size_t N, size_t Hop>
+bool spectrum_follows(const SpectrumAnalyzer<Msg::axes, N, Hop> &analyzer, const Sample<Msg> &sample) {
+    if (sample.decimation != analyzer.decimation)
+        return false;
+    if (analyzer.last_subsample + 1 < analyzer.subsamples)
+        return sample.cycle == analyzer.last_cycle && sample.subsample == analyzer.last_subsample + 1;
+    return sample.cycle == analyzer.last_cycle + analyzer.decimation && sample.subsample == 0;
+}
+
+/**
+ * @brief Transforms the newest N samples of every field and averages the spectra in
+ */
+template <size_t Axes, size_t N, size_t Hop>
+void spectrum_frame(SpectrumAnalyzer<Axes, N, Hop> &analyzer) {
+    constexpr size_t bins = SpectrumAnalyzer<Axes, N, Hop>::bins;
+    float frame[N];
+    float power[bins];
+
+    const size_t start = analyzer.written % N; // oldest sample in the circular history
+    const float a = analyzer.frames == 0 ? 1.0f : analyzer.smoothing;
+    for (size_t axis = 0; axis < Axes; ++axis) {
+        memcpy(frame, analyzer.history[axis] + start, (N - start) * sizeof(float));
+        memcpy(frame + (N - start), analyzer.history[axis], start * sizeof(float));
+
+        // Remove the mean so the window does not smear DC into the low bins
+        float mean = 0.0f;
+        for (size_t n = 0; n < N; ++n)
+            mean += frame[n];
+        mean /= static_cast<float>(N);
+        for (size_t n = 0; n < N; ++n)
+            frame[n] -= mean;
+
+        fft_real_power(analyzer.plan, frame, power);
+
+        float *avg = analyzer.power[axis];
+        for (size_t k = 0; k < bins; ++k)
+            avg[k] += a * (power[k] - avg[k]);
+    }
+    analyzer.frames += 1;
+    analyzer.since_frame = 0;
+}
+
+/**
+ * @brief Adds a batch of drained samples, transforming a frame every `Hop` samples
+ *
+ * Restarts the history at gaps and rate changes, see SpectrumAnalyzer.
+ *
+ * @param analyzer The analyzer to update
+ * @param samples The drained samples, oldest first
+ * @param n Number of samples
+ * @return Number of new frames
+ */
+template <typename Msg, size_t N, size_t Hop>
+size_t spectrum_add_samples(SpectrumAnalyzer<Msg::axes, N, Hop> &analyzer, const Sample<Msg> *samples, size_t n) {
+    size_t frames = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (analyzer.decimation != 0 && !spectrum_follows(analyzer, samples[i])) {
+            if (samples[i].decimation != analyzer.decimation) {
+                memset(analyzer.power, 0, sizeof(analyzer.power));
+                analyzer.frames = 0;
+            }
+            analyzer.written = 0;
+            analyzer.since_frame = 0;
+            analyzer.resets += 1;
+        }
+        analyzer.decimation = samples[i].decimation;
+        analyzer.last_cycle = samples[i].cycle;
+        analyzer.last_subsample = samples[i].subsample;
+
+        const size_t slot = analyzer.written % N;
+        for (size_t axis = 0; axis < Msg::axes; ++axis)
+            analyzer.history[axis][slot] = static_cast<float>(samples[i].msg.arrayOfNumbers[axis]);
+        analyzer.written += 1;
+        analyzer.since_frame += 1;
+
+        if (analyzer.written >= N && analyzer.since_frame >= Hop) {
+            spectrum_frame(analyzer);
+            frames += 1;
+        }
+    }
+    return frames;
+}
+
+/**
+ * @brief Strongest bin of a field's averaged spectrum, ignoring bins below `first_bin`
+ *
+ * Frames have their mean removed, so bin 0 only holds leftover drift.
+ */
+template <size_t Axes, size_t N, size_t Hop>
+size_t spectrum_peak(const SpectrumAnalyzer<Axes, N, Hop> &analyzer, size_t axis, size_t first_bin = 1) {
+    const float *power = analyzer.power[axis];
+    size_t best = first_bin;
+    for (size_t k = first_bin + 1; k < SpectrumAnalyzer<Axes, N, Hop>::bins; ++k)
+        best = power[k] > power[best] ? k : best;
+    return best;
+}
+
+/**
+ * @brief Frequency of bin `k` in Hz for a given sample rate
+ */
+template <size_t Axes, size_t N, size_t Hop>
+double spectrum_bin_hz(const SpectrumAnalyzer<Axes, N, Hop> &, size_t k, double sample_rate_hz) {
+    return static_cast<double>(k) * sample_rate_hz / static_cast<double>(N);
+}
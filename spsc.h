@@ -0,0 +1,552 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <atomic>
+#include <iterator>
+#include <new>
+#include <type_traits>
+
+/**
+ * @brief A generic message structure for communication between threads.
+ *
+ * This simple "Plain Old Data" (POD) struct is used for both sending commands
+ * from the Observer to the RT thread and for sending data back from the RT
+ * thread to the Observer. It carries one value of type T per axis (cable),
+ * so a 4-cable rig uses BasicMessage<4> and a 12-cable rig BasicMessage<12>.
+ */
+template <size_t Axes, typename T = float>
+struct BasicMessage {
+    static constexpr size_t axes = Axes;
+    using value_type = T;
+
+    T arrayOfNumbers[Axes];
+    bool keepRunning;
+};
+
+// The default eight-axis message
+using Message = BasicMessage<8>;
+
+// This is a compile-time check that ensures the Message struct is "trivially copyable".
+// This is critical for high-performance applications because it guarantees that
+// copying a Message can be done with a simple, fast, bit-for-bit memory copy (like memcpy),
+// without any unexpected side effects from user-defined constructors or destructors.
+static_assert(std::is_trivially_copyable_v<Message>,"Message must be trivial.");
+
+/**
+ * @brief A lock-free SPSC queue for the RT -> Observer data channel.
+ *
+ * This struct implements one half of a bidirectional SPSC communication
+ * system. It serves as the channel for the RT thread to
+ * send a stream of data messages for the Observer thread to read from. The other direction,
+ * for sending commands, is handled by the Mailbox.
+ *
+ * `head` and `tail` are free-running counters of type Index that are only
+ * ever compared by their difference, so they may wrap. That is exact as long
+ * as Capacity is a power of two no larger than half the Index range, which is
+ * checked below.
+ *
+ * IndexAlign is the alignment of `head`, `tail` and `buf`. The default, 64,
+ * puts each on its own cache line, so the producer storing `head` does not
+ * invalidate the line the consumer stores `tail` to, and neither shares a line
+ * with the messages. The padding then dominates the overhead and a narrow
+ * Index saves nothing. CompactRing packs all three instead, for many small,
+ * rarely busy channels where memory matters more than contention; only there
+ * does a uint16_t or uint32_t Index help. Measured on x86-64 (GCC):
+ *
+ *   BasicRing<Message>                        448 bytes
+ *   BasicRing<Message, uint16_t>              448 bytes
+ *   CompactRing<Message>                      304 bytes
+ *   CompactRing<Message, uint16_t>            292 bytes
+ *   BasicRing<uint32_t, uint16_t, 16>         192 bytes
+ *   CompactRing<uint32_t, size_t, 16>          80 bytes
+ *   CompactRing<uint32_t, uint16_t, 16>        68 bytes
+ */
+template <typename Msg, typename Index = size_t, size_t Capacity = 8, size_t IndexAlign = 64>
+struct alignas(IndexAlign) BasicRing {
+    static_assert(std::is_trivially_copyable_v<Msg>, "Ring messages must be trivial.");
+    static_assert(std::is_unsigned_v<Index>, "Ring index must be an unsigned integer.");
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two.");
+    static_assert(Capacity <= (static_cast<Index>(~Index{0}) >> 1) + 1, "Ring capacity is too large for the index type.");
+    static_assert(std::atomic<Index>::is_always_lock_free, "Ring indices must be lock-free.");
+    static_assert(IndexAlign >= alignof(std::atomic<Index>), "Ring index alignment is too small.");
+
+    alignas(IndexAlign) std::atomic<Index> head{0};
+
+    alignas(IndexAlign) std::atomic<Index> tail{0};
+
+    alignas(IndexAlign) Msg buf[Capacity];
+};
+
+/**
+ * @brief A BasicRing without cache-line padding between its indices and messages
+ */
+template <typename Msg, typename Index = size_t, size_t Capacity = 8>
+using CompactRing = BasicRing<Msg, Index, Capacity, alignof(std::atomic<Index>)>;
+
+// The original 8-slot ring of eight-axis messages with machine-word indices
+using Ring = BasicRing<Message>;
+
+/**
+ * @brief One Mailbox slot, padded to its own cache line(s).
+ *
+ * Without the padding both slots share a cache line, so the Observer writing
+ * the back slot would invalidate the line the RT thread is reading the front
+ * slot from.
+ */
+template <typename Msg>
+struct alignas(64) MailboxSlot {
+    Msg msg;
+};
+
+/**
+ * @brief A lock-free SPSC mailbox for the Observer -> RT command channel.
+ *
+ * This struct implements one half of a bidirectional SPSC communication
+ * system. It serves as the "last value matters" channel for the Observer
+ * thread to send command updates to the RT thread. The other direction, for
+ * sending a stream of data, is handled by the Ring queue.
+ *
+ * `sequence` counts the commands published so far; its lowest bit selects
+ * the slot holding the latest one. The RT thread can compare it between
+ * cycles to tell when a new command arrived.
+ */
+template <typename Msg>
+struct BasicMailbox {
+    static_assert(std::is_trivially_copyable_v<Msg>, "Mailbox messages must be trivial.");
+
+    MailboxSlot<Msg> slots[2];
+
+    alignas(64) std::atomic<uint64_t> sequence{0};
+};
+
+using Mailbox = BasicMailbox<Message>;
+
+/**
+ * @brief Sends a command from the Observer thread to the RT thread
+ *
+ * This function is called by the low-frequency Observer thread to update the
+ * command state for the RT thread. It uses a double-buffer mailbox to ensure
+ * the command is sent safely without blocking and without data corruption
+ *
+ * With `only_if_changed` set, a command that is byte-identical to the one
+ * currently published is not written at all, so an unchanged Observer update
+ * does not touch any cache line the RT thread reads.
+ *
+ * @param mailbox The Mailbox to send the command to
+ * @param command The Message object containing the command data
+ * @param only_if_changed Skip publishing if the command has not changed
+ * @return true if the command was published, false if it was skipped
+ */
+template <typename Msg>
+bool send_command(BasicMailbox<Msg> &mailbox, const Msg &command, bool only_if_changed = false) {
+    const uint64_t current = mailbox.sequence.load(std::memory_order_relaxed);
+    const size_t current_idx = current & 1;
+    const size_t write_idx = 1 - current_idx;
+
+    // Only the Observer ever writes the slots, so reading the front one here is safe
+    if (only_if_changed && memcmp(&mailbox.slots[current_idx].msg, &command, sizeof(Msg)) == 0)
+        return false;
+
+    mailbox.slots[write_idx].msg = command;
+
+    mailbox.sequence.store(current + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Safely peeks at the latest message in the mailbox
+ * @param mailbox The mailbox to peek from
+ * @return A copy of the latest, complete message
+ */
+template <typename Msg>
+Msg peek(BasicMailbox<Msg> &mailbox) {
+    const uint64_t sequence = mailbox.sequence.load(std::memory_order_acquire);
+
+    return mailbox.slots[sequence & 1].msg;
+}
+
+/**
+ * @brief Peeks at the latest message and reports which publication it was
+ * @param mailbox The mailbox to peek from
+ * @param[out] sequence Number of commands published up to and including this one
+ * @return A copy of the latest, complete message
+ */
+template <typename Msg>
+Msg peek(BasicMailbox<Msg> &mailbox, uint64_t &sequence) {
+    sequence = mailbox.sequence.load(std::memory_order_acquire);
+
+    return mailbox.slots[sequence & 1].msg;
+}
+
+/**
+ * @brief Tries to push a data message from the RT thread into the queue
+ *
+ * This function is called by the high-frequency RT thread to send data back
+ * to the Observer thread. It is non-blocking; if the queue is full, it will
+ * immediately return false, dropping the message
+ *
+ * @param queue The queue to push the message into
+ * @param message The Message object containing the data to be pushed
+ * @return true if the message was successfully pushed, false if the queue was full
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+bool try_push(BasicRing<Msg, Index, Capacity, IndexAlign> &queue, const Msg &message) {
+    Index h = queue.head.load(std::memory_order_relaxed);
+    Index t = queue.tail.load(std::memory_order_acquire);
+    if (static_cast<Index>(h - t) == Capacity) // full
+        return false;
+
+    queue.buf[h & (Capacity - 1)] = message;
+    queue.head.store(static_cast<Index>(h + 1), std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Tries to pop a data message from the queue for the Observer thread.
+ *
+ * This function is called by the low-frequency Observer thread to read data
+ * sent by the RT thread. It is non-blocking; if the queue is empty, it will
+ * immediately return false
+ *
+ * @param queue The queue to pop the message from
+ * @param[out] out The Message object where the popped data will be stored
+ * @return true if a message was successfully popped, false if the queue was empty
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+bool try_pop(BasicRing<Msg, Index, Capacity, IndexAlign> &queue, Msg &out){
+    Index t = queue.tail.load(std::memory_order_relaxed);
+    Index h = queue.head.load(std::memory_order_acquire);
+    if (t==h){ // empty
+        return false;
+    }
+
+    out = queue.buf[t & (Capacity - 1)];
+    queue.tail.store(static_cast<Index>(t + 1), std::memory_order_release);
+    return true;
+}
+
+/**
+ * @brief Pops up to `max` messages straight from ring memory into a file descriptor
+ *
+ * Called by the consumer instead of try_pop when the messages only need to be
+ * serialized (recording, export). The unread messages occupy at most two
+ * contiguous runs of `buf`, which are handed to a single writev, so the data
+ * goes from the ring to the kernel without an intermediate copy. `tail` is
+ * advanced by the number of whole messages written; if the kernel accepted
+ * part of a message, the rest of that message is written before returning so
+ * the stream never contains a torn message.
+ *
+ * If writing that rest fails, `tail` still moves past the whole messages that
+ * were delivered, so they are never sent twice; the fd then ends in a torn
+ * message and should not be written to again.
+ *
+ * @param queue The queue to drain
+ * @param fd The file descriptor to write to
+ * @param max Maximum number of messages to drain
+ * @return Number of messages drained, or -1 if the write failed (errno is set)
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+ssize_t drain_to_fd(BasicRing<Msg, Index, Capacity, IndexAlign> &queue, int fd, size_t max) {
+    Index t = queue.tail.load(std::memory_order_relaxed);
+    Index h = queue.head.load(std::memory_order_acquire);
+    size_t n = static_cast<Index>(h - t);
+    if (n > max)
+        n = max;
+    if (n == 0)
+        return 0;
+
+    const size_t first = t & (Capacity - 1);
+    const size_t run = n < Capacity - first ? n : Capacity - first;
+    struct iovec iov[2] = {
+        {&queue.buf[first], run * sizeof(Msg)},
+        {&queue.buf[0], (n - run) * sizeof(Msg)},
+    };
+
+    ssize_t written;
+    do {
+        written = writev(fd, iov, n > run ? 2 : 1);
+    } while (written < 0 && errno == EINTR);
+    if (written < 0)
+        return -1;
+
+    size_t done = static_cast<size_t>(written) / sizeof(Msg);
+    size_t partial = static_cast<size_t>(written) % sizeof(Msg);
+    if (partial > 0) {
+        const uint8_t *rest = reinterpret_cast<const uint8_t *>(&queue.buf[(t + done) & (Capacity - 1)]) + partial;
+        size_t left = sizeof(Msg) - partial;
+        while (left > 0) {
+            ssize_t w = write(fd, rest, left);
+            if (w < 0 && errno == EINTR)
+                continue;
+            if (w <= 0) {
+                if (w == 0)
+                    errno = EIO;
+                queue.tail.store(static_cast<Index>(t + done), std::memory_order_release);
+                return -1;
+            }
+            rest += w;
+            left -= static_cast<size_t>(w);
+        }
+        done += 1;
+    }
+
+    queue.tail.store(static_cast<Index>(t + done), std::memory_order_release);
+    return static_cast<ssize_t>(done);
+}
+
+/**
+ * @brief Writes a message into the queue without making it visible yet
+ *
+ * Used by the RT thread to collect several messages (e.g. oversampled
+ * sub-samples of one cycle) and then publish all of them with a single
+ * release store via publish_staged(). `staged` counts the messages written
+ * since the last publish and must start at zero.
+ *
+ * @param queue The queue to write into
+ * @param message The message to stage
+ * @param staged Number of messages staged so far; incremented on success
+ * @return true if the message was staged, false if the queue is full
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+bool try_stage(BasicRing<Msg, Index, Capacity, IndexAlign> &queue, const Msg &message, size_t &staged) {
+    Index h = static_cast<Index>(queue.head.load(std::memory_order_relaxed) + staged);
+    Index t = queue.tail.load(std::memory_order_acquire);
+    if (static_cast<Index>(h - t) == Capacity) // full
+        return false;
+
+    queue.buf[h & (Capacity - 1)] = message;
+    staged += 1;
+    return true;
+}
+
+/**
+ * @brief Makes every staged message visible to the consumer at once
+ * @param queue The queue that was written into
+ * @param staged Number of staged messages; reset to zero
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+void publish_staged(BasicRing<Msg, Index, Capacity, IndexAlign> &queue, size_t &staged) {
+    if (staged == 0)
+        return;
+
+    Index h = queue.head.load(std::memory_order_relaxed);
+    queue.head.store(static_cast<Index>(h + staged), std::memory_order_release);
+    staged = 0;
+}
+
+/**
+ * @brief Number of messages currently waiting in the queue
+ *
+ * The caller's own index is exact and the other side's may be stale. From the
+ * producer the result can therefore overestimate by whatever the consumer
+ * popped concurrently, and from the consumer it can underestimate by whatever
+ * the producer pushed concurrently. It is exact while the other side is idle.
+ *
+ * @param queue The queue to inspect
+ * @return The number of unread messages
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+size_t ring_occupancy(const BasicRing<Msg, Index, Capacity, IndexAlign> &queue) {
+    Index h = queue.head.load(std::memory_order_relaxed);
+    Index t = queue.tail.load(std::memory_order_acquire);
+    return static_cast<Index>(h - t);
+}
+
+/**
+ * @brief A lossy SPSC queue whose producer never waits for the consumer.
+ *
+ * Unlike Ring, a push into a full OverwriteRing succeeds by replacing the
+ * oldest unread message. Each slot carries a sequence number written before
+ * and after the message (a per-slot seqlock), so the consumer can tell when a
+ * slot was overwritten while it was copying it and skip it. Messages that were
+ * overwritten before they could be read are counted in `lost`.
+ *
+ * `tail` and `lost` are only ever touched by the consumer.
+ */
+template <typename Msg, size_t Capacity = 8>
+struct alignas(64) BasicOverwriteRing {
+    static_assert(std::is_trivially_copyable_v<Msg>, "Ring messages must be trivial.");
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Ring capacity must be a power of two.");
+
+    struct Slot {
+        std::atomic<uint64_t> seq{0};
+        Msg msg;
+    };
+
+    std::atomic<uint64_t> head{0};
+
+    alignas(64) uint64_t tail = 0;
+    uint64_t lost = 0;
+
+    alignas(64) Slot slots[Capacity];
+};
+
+/**
+ * @brief Pushes a message, overwriting the oldest unread one if the queue is full
+ * @param queue The queue to push the message into
+ * @param message The message to push
+ */
+template <typename Msg, size_t Capacity>
+void push_overwrite(BasicOverwriteRing<Msg, Capacity> &queue, const Msg &message) {
+    uint64_t h = queue.head.load(std::memory_order_relaxed);
+    auto &slot = queue.slots[h & (Capacity - 1)];
+
+    // Odd sequence: slot is being written
+    slot.seq.store(2 * h + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.msg = message;
+    slot.seq.store(2 * h + 2, std::memory_order_release);
+
+    queue.head.store(h + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Tries to pop the oldest message that has not been overwritten yet
+ * @param queue The queue to pop the message from
+ * @param[out] out The message that was popped
+ * @return true if a message was popped, false if the queue was empty
+ */
+template <typename Msg, size_t Capacity>
+bool try_pop(BasicOverwriteRing<Msg, Capacity> &queue, Msg &out) {
+    while (true) {
+        uint64_t h = queue.head.load(std::memory_order_acquire);
+        if (queue.tail == h) // empty
+            return false;
+
+        if (h - queue.tail > Capacity) { // the producer lapped us
+            queue.lost += h - queue.tail - Capacity;
+            queue.tail = h - Capacity;
+        }
+
+        auto &slot = queue.slots[queue.tail & (Capacity - 1)];
+        const uint64_t expected = 2 * queue.tail + 2;
+        const uint64_t before = slot.seq.load(std::memory_order_acquire);
+        out = slot.msg;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t after = slot.seq.load(std::memory_order_relaxed);
+
+        queue.tail += 1;
+        if (before == expected && after == expected)
+            return true;
+
+        queue.lost += 1; // overwritten while we were reading it
+    }
+}
+
+// Channels placed in shared or file-backed memory are accessed through
+// atomics from several mappings or processes, which is only sound when the
+// atomics are implemented without a hidden lock.
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Mailbox and overwrite-ring sequences must be lock-free.");
+
+/**
+ * @brief Checks that caller-provided memory can hold a channel of type Channel
+ * @param memory Start of the region
+ * @param size Size of the region in bytes
+ * @return true if the region is large enough and suitably aligned
+ */
+template <typename Channel>
+bool channel_fits(const void *memory, size_t size) {
+    const auto addr = reinterpret_cast<uintptr_t>(memory);
+    return memory != nullptr && size >= sizeof(Channel) && addr % alignof(Channel) == 0;
+}
+
+/**
+ * @brief Constructs a new, empty channel inside caller-provided memory
+ *
+ * Use this for a shm segment, a huge-page region, a locked arena or a
+ * file-backed mapping that the channel should live in. The returned pointer
+ * works with the same send_command/peek/try_push/try_pop functions as a
+ * channel declared as a normal variable. The memory must outlive every user
+ * of the channel; the channel is trivially destructible and needs no cleanup.
+ *
+ * @param memory Start of the region, aligned to alignof(Channel)
+ * @param size Size of the region in bytes, at least sizeof(Channel)
+ * @return The constructed channel, or nullptr if the region is unsuitable
+ */
+template <typename Channel>
+Channel *channel_create_at(void *memory, size_t size) {
+    static_assert(std::is_trivially_destructible_v<Channel>, "Channel must not need a destructor.");
+    if (!channel_fits<Channel>(memory, size))
+        return nullptr;
+
+    return new (memory) Channel{};
+}
+
+/**
+ * @brief Attaches to a channel that was already created in caller-provided memory
+ *
+ * This is how a second process (or a second mapping of the same file) joins a
+ * channel that channel_create_at() set up. The contents are not touched.
+ *
+ * @param memory Start of the region, aligned to alignof(Channel)
+ * @param size Size of the region in bytes, at least sizeof(Channel)
+ * @return The existing channel, or nullptr if the region is unsuitable
+ */
+template <typename Channel>
+Channel *channel_attach(void *memory, size_t size) {
+    if (!channel_fits<Channel>(memory, size))
+        return nullptr;
+
+    return std::launder(static_cast<Channel *>(memory));
+}
+
+/**
+ * @brief Creates (or replaces) the POSIX shm object `/name` and constructs a channel in it
+ * @param name POSIX shm name, starting with '/'
+ * @return The channel, or nullptr on failure
+ */
+template <typename Channel>
+Channel *shm_channel_create(const char *name) {
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+        return nullptr;
+    if (ftruncate(fd, sizeof(Channel)) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    void *map = mmap(nullptr, sizeof(Channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return nullptr;
+    return channel_create_at<Channel>(map, sizeof(Channel));
+}
+
+/**
+ * @brief Attaches to a channel another process created with shm_channel_create()
+ * @param name POSIX shm name, starting with '/'
+ * @return The channel, or nullptr if it does not exist or has the wrong size
+ */
+template <typename Channel>
+Channel *shm_channel_attach(const char *name) {
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) != sizeof(Channel)) {
+        close(fd);
+        return nullptr;
+    }
+    void *map = mmap(nullptr, sizeof(Channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return nullptr;
+    return channel_attach<Channel>(map, sizeof(Channel));
+}
+
+/**
+ * @brief Unmaps a shm channel; with `name` given, also removes the shm object
+ */
+template <typename Channel>
+void shm_channel_detach(Channel *channel, const char *name = nullptr) {
+    munmap(channel, sizeof(Channel));
+    if (name != nullptr)
+        shm_unlink(name);
+}
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <type_traits>
+
+#include "spsc.h"
+
+/**
+ * @brief A routine telemetry record sent from the RT thread to the Observer.
+ *
+ * Wraps one data message with the RT cycle it was produced in, so the
+ * Observer can tell which cycles are missing from the stream. `decimation`
+ * is the RT-side rate divider in effect when the sample was taken (one sample
+ * every `decimation` cycles), so consumers can interpolate correctly.
+ * `subsample` numbers the oversampled readings taken within one cycle.
+ * `time_ns` is the CLOCK_REALTIME time the sample was taken (0 if the RT
+ * thread did not stamp it); recordings are indexed by it.
+ */
+template <typename Msg>
+struct Sample {
+    uint64_t cycle;
+    Msg msg;
+    uint32_t decimation = 1;
+    uint32_t subsample = 0;
+    int64_t time_ns = 0;
+};
+
+/**
+ * @brief Current CLOCK_REALTIME time in nanoseconds, for stamping samples
+ */
+inline int64_t realtime_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Codes carried by TelemetryEvent.
+ */
+enum EventCode : uint32_t {
+    EVENT_STATE_CHANGE = 1,
+    EVENT_FAULT = 2,
+    EVENT_SHUTDOWN = 3,
+};
+
+/**
+ * @brief A fault or state-change notification from the RT thread.
+ *
+ * Events travel on their own lane of a TelemetryChannel so that routine
+ * samples can never push them out.
+ */
+struct TelemetryEvent {
+    uint64_t cycle;
+    uint32_t code;
+    float value;
+};
+
+static_assert(std::is_trivially_copyable_v<TelemetryEvent>, "TelemetryEvent must be trivial.");
+
+/**
+ * @brief What the bulk lane of a TelemetryChannel does when the Observer falls behind.
+ */
+enum class BulkPolicy {
+    DropNewest,     // like try_push: the new sample is dropped
+    OverwriteOldest // the oldest unread sample is replaced
+};
+
+/**
+ * @brief A two-lane RT -> Observer telemetry channel.
+ *
+ * The critical lane is a small Ring reserved for TelemetryEvent and is never
+ * shared with routine traffic. If it is full, events are parked in an
+ * RT-private backlog and re-sent, in order, on the next post or flush, so an
+ * event is only ever lost if the Observer stops draining for long enough to
+ * overflow both (counted in `events_lost`). The bulk lane carries Samples with
+ * the drop or overwrite semantics chosen by Policy.
+ *
+ * The bulk lane has to hold everything the RT thread produces between two
+ * Observer drains, including whole batches of oversampled sub-samples. The
+ * default of 128 samples covers six cycles of 20 sub-samples (10 kHz readings
+ * in a 2 ms cycle); size it up for faster sensors or slower drains.
+ */
+template <typename Msg, BulkPolicy Policy = BulkPolicy::DropNewest,
+          size_t BulkCapacity = 128, size_t CriticalCapacity = 16>
+struct TelemetryChannel {
+    static constexpr size_t bulk_capacity = BulkCapacity;
+
+    using BulkLane = std::conditional_t<Policy == BulkPolicy::OverwriteOldest,
+                                        BasicOverwriteRing<Sample<Msg>, BulkCapacity>,
+                                        BasicRing<Sample<Msg>, size_t, BulkCapacity>>;
+
+    BasicRing<TelemetryEvent, uint32_t, CriticalCapacity> critical;
+
+    BulkLane bulk;
+
+    // RT-private state
+    alignas(64) TelemetryEvent backlog[CriticalCapacity];
+    size_t backlog_count = 0;
+    uint64_t events_lost = 0;
+    uint64_t samples_dropped = 0;
+};
+
+/**
+ * @brief Moves as many backlogged events as fit into the critical lane
+ *
+ * Called from the RT thread; telemetry_post_event() does this implicitly,
+ * but the RT loop should also call it once per cycle so that a backlog drains
+ * even when no new events are posted.
+ *
+ * @param channel The channel to flush
+ * @return true if the backlog is now empty
+ */
+template <typename Msg, BulkPolicy Policy, size_t B, size_t C>
+bool telemetry_flush_events(TelemetryChannel<Msg, Policy, B, C> &channel) {
+    size_t sent = 0;
+    while (sent < channel.backlog_count && try_push(channel.critical, channel.backlog[sent]))
+        sent += 1;
+
+    if (sent > 0) {
+        for (size_t i = sent; i < channel.backlog_count; ++i)
+            channel.backlog[i - sent] = channel.backlog[i];
+        channel.backlog_count -= sent;
+    }
+    return channel.backlog_count == 0;
+}
+
+/**
+ * @brief Posts a fault or state-change event from the RT thread
+ *
+ * Events are delivered in the order they were posted. If the critical lane is
+ * full the event is kept in the backlog instead of being dropped.
+ *
+ * @param channel The channel to post on
+ * @param event The event to deliver
+ * @return true if the event was queued (on the lane or in the backlog), false if it was lost
+ */
+template <typename Msg, BulkPolicy Policy, size_t B, size_t C>
+bool telemetry_post_event(TelemetryChannel<Msg, Policy, B, C> &channel, const TelemetryEvent &event) {
+    if (telemetry_flush_events(channel) && try_push(channel.critical, event))
+        return true;
+
+    if (channel.backlog_count == C) {
+        channel.events_lost += 1;
+        return false;
+    }
+    channel.backlog[channel.backlog_count++] = event;
+    return true;
+}
+
+/**
+ * @brief Pushes a routine sample from the RT thread onto the bulk lane
+ * @param channel The channel to push on
+ * @param sample The sample to push
+ * @return true if the sample was queued, false if it was dropped
+ */
+template <typename Msg, BulkPolicy Policy, size_t B, size_t C>
+bool telemetry_push_sample(TelemetryChannel<Msg, Policy, B, C> &channel, const Sample<Msg> &sample) {
+    if constexpr (Policy == BulkPolicy::OverwriteOldest) {
+        push_overwrite(channel.bulk, sample);
+        return true;
+    } else {
+        if (try_push(channel.bulk, sample))
+            return true;
+        channel.samples_dropped += 1;
+        return false;
+    }
+}
+
+/**
+ * @brief Stages one oversampled sub-sample on the bulk lane without publishing it
+ *
+ * The RT thread calls this for each sub-sample it reads during a cycle and
+ * then telemetry_publish_samples() once at the end of the cycle, so the whole
+ * batch costs a single cross-core index update. Sub-samples that do not fit in
+ * the bulk lane are dropped, so a cycle's batch must be well below its
+ * capacity (see TelemetryChannel).
+ *
+ * @param channel The channel to stage on
+ * @param sample The sub-sample
+ * @param staged Sub-samples staged this cycle (start at zero)
+ * @return true if the sub-sample was staged, false if it was dropped
+ */
+template <typename Msg, size_t B, size_t C>
+bool telemetry_stage_sample(TelemetryChannel<Msg, BulkPolicy::DropNewest, B, C> &channel,
+                            const Sample<Msg> &sample, size_t &staged) {
+    if (try_stage(channel.bulk, sample, staged))
+        return true;
+    channel.samples_dropped += 1;
+    return false;
+}
+
+/**
+ * @brief Publishes every sub-sample staged this cycle with one release store
+ * @param channel The channel that was staged on
+ * @param staged Sub-samples staged this cycle; reset to zero
+ */
+template <typename Msg, size_t B, size_t C>
+void telemetry_publish_samples(TelemetryChannel<Msg, BulkPolicy::DropNewest, B, C> &channel, size_t &staged) {
+    publish_staged(channel.bulk, staged);
+}
+
+/**
+ * @brief Drains both lanes from the Observer thread, critical lane first
+ *
+ * Every pending event is handed to `on_event` before any sample is handed to
+ * `on_sample`. Events that arrive while samples are being drained are picked
+ * up before returning.
+ *
+ * @param channel The channel to drain
+ * @param on_event Called as on_event(const TelemetryEvent &)
+ * @param on_sample Called as on_sample(const Sample<Msg> &)
+ * @return The number of samples drained
+ */
+template <typename Msg, BulkPolicy Policy, size_t B, size_t C, typename OnEvent, typename OnSample>
+size_t telemetry_drain(TelemetryChannel<Msg, Policy, B, C> &channel, OnEvent &&on_event, OnSample &&on_sample) {
+    TelemetryEvent event;
+    while (try_pop(channel.critical, event))
+        on_event(event);
+
+    size_t count = 0;
+    Sample<Msg> sample;
+    while (try_pop(channel.bulk, sample)) {
+        on_sample(sample);
+        count += 1;
+    }
+
+    while (try_pop(channel.critical, event))
+        on_event(event);
+    return count;
+}
+
+/**
+ * @brief RT-side policy that lowers the telemetry rate while the Observer falls behind.
+ *
+ * Instead of dropping samples whenever the bulk lane happens to be full, the
+ * RT thread only sends every `decimation`-th cycle and adapts that factor to
+ * the lane occupancy it sees when it sends: at or above `high_water` the
+ * factor doubles (up to `max_decimation`), and once the occupancy has stayed
+ * at or below `low_water` for `hold_sends` consecutive sends it halves again.
+ * The gap between the two watermarks and the hold count keep it from
+ * oscillating. Set it up with rate_governor_init(), which rejects settings
+ * the policy cannot work with.
+ */
+struct RateGovernor {
+    size_t high_water;
+    size_t low_water;
+    uint32_t hold_sends;
+    uint32_t max_decimation;
+
+    // RT-private state
+    uint32_t decimation = 1;
+    uint32_t calm_sends = 0;
+};
+
+/**
+ * @brief Configures a RateGovernor and resets it to full rate
+ * @param governor The governor to set up
+ * @param high_water Occupancy at or above which the rate is halved
+ * @param low_water Occupancy at or below which the rate may be doubled; below `high_water`
+ * @param hold_sends Consecutive calm sends needed before doubling the rate
+ * @param max_decimation Largest divider; need not be a power of two, must be at least 1
+ * @return false if the settings are invalid
+ */
+inline bool rate_governor_init(RateGovernor &governor, size_t high_water, size_t low_water, uint32_t hold_sends,
+                               uint32_t max_decimation) {
+    if (low_water >= high_water || max_decimation == 0)
+        return false;
+    governor.high_water = high_water;
+    governor.low_water = low_water;
+    governor.hold_sends = hold_sends;
+    governor.max_decimation = max_decimation;
+    governor.decimation = 1;
+    governor.calm_sends = 0;
+    return true;
+}
+
+/**
+ * @brief Decides on the RT thread whether to send this cycle and adapts the rate
+ * @param governor The governor state
+ * @param occupancy Current occupancy of the bulk lane (see ring_occupancy)
+ * @param cycle This cycle's number
+ * @return true if a sample should be sent this cycle, tagged with governor.decimation
+ */
+inline bool rate_should_send(RateGovernor &governor, size_t occupancy, uint64_t cycle) {
+    if (cycle % governor.decimation != 0)
+        return false;
+
+    if (occupancy >= governor.high_water) {
+        governor.calm_sends = 0;
+        if (governor.decimation < governor.max_decimation) {
+            const uint64_t doubled = uint64_t{governor.decimation} * 2;
+            governor.decimation = doubled < governor.max_decimation ? static_cast<uint32_t>(doubled)
+                                                                    : governor.max_decimation;
+        }
+    } else if (occupancy <= governor.low_water) {
+        governor.calm_sends += 1;
+        if (governor.calm_sends >= governor.hold_sends && governor.decimation > 1) {
+            governor.decimation /= 2;
+            governor.calm_sends = 0;
+        }
+    } else {
+        governor.calm_sends = 0;
+    }
+
+    // The factor may have just changed; stay aligned to the new stride
+    return cycle % governor.decimation == 0;
+}
+
+/**
+ * @brief Pushes a sample on the bulk lane at the rate chosen by a RateGovernor
+ *
+ * Only meaningful with BulkPolicy::DropNewest, where the RT thread can see how
+ * far behind the Observer is.
+ *
+ * @param channel The channel to push on
+ * @param governor The governor state
+ * @param sample The sample for this cycle; its decimation field is filled in
+ * @return true if a sample was pushed this cycle
+ */
+template <typename Msg, size_t B, size_t C>
+bool telemetry_push_adaptive(TelemetryChannel<Msg, BulkPolicy::DropNewest, B, C> &channel,
+                             RateGovernor &governor, Sample<Msg> sample) {
+    if (!rate_should_send(governor, ring_occupancy(channel.bulk), sample.cycle))
+        return false;
+
+    sample.decimation = governor.decimation;
+    return telemetry_push_sample(channel, sample);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+/*
+ * Minimal checks shared by the unit tests. Each test binary calls its test
+ * functions from main() and returns check_report(), which ctest reads.
+ */
+
+inline int &check_failures() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void check(bool ok, const char *what, const char *file, int line) {
+    if (!ok) {
+        printf("FAIL %s:%d: %s\n", file, line, what);
+        check_failures() += 1;
+    }
+}
+
+#define CHECK(...) check((__VA_ARGS__), #__VA_ARGS__, __FILE__, __LINE__)
+
+/**
+ * @brief Prints the outcome of a test binary
+ * @return The exit status for ctest: 0 if every check passed
+ */
+inline int check_report() {
+    if (check_failures() > 0) {
+        printf("%d check(s) failed\n", check_failures());
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
+
+/**
+ * @brief Creates a fresh scratch directory for files a test writes
+ */
+inline std::string check_temp_dir() {
+    char path[] = "/tmp/spsc_test.XXXXXX";
+    if (mkdtemp(path) == nullptr) {
+        perror("mkdtemp");
+        exit(2);
+    }
+    return path;
+}
+
+/**
+ * @brief Removes a scratch directory and the files in it
+ */
+inline void check_remove_dir(const std::string &dir) {
+    DIR *entries = opendir(dir.c_str());
+    if (entries != nullptr) {
+        while (struct dirent *entry = readdir(entries)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                unlink((dir + "/" + entry->d_name).c_str());
+        }
+        closedir(entries);
+    }
+    rmdir(dir.c_str());
+}
@@ -0,0 +1,95 @@
+#include <math.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <initializer_list>
+#include <string>
+
+#include "bench_results.h"
+#include "check.h"
+
+/*
+ * Tests for the statistics spsc_compare applies to benchmark series, and for the results file.
+ */
+
+static BenchSeries series_of(std::initializer_list<std::pair<uint32_t, uint64_t>> buckets) {
+    BenchSeries series;
+    for (const auto &bucket : buckets) {
+        series.buckets.push_back(bucket);
+        series.count += bucket.second;
+    }
+    series.max_us = series.buckets.back().first + 0.5;
+    return series;
+}
+
+static void test_mann_whitney() {
+    // No overlap: U = 9 of 9, z = 4.5 / sqrt(5.25)
+    MannWhitney test = mann_whitney(series_of({{1, 1}, {2, 1}, {3, 1}}), series_of({{4, 1}, {5, 1}, {6, 1}}));
+    CHECK(fabs(test.effect - 1.0) < 1e-12);
+    CHECK(fabs(test.z - 1.9639610121) < 1e-9);
+    CHECK(fabs(test.p_value - 0.0247673067) < 1e-9);
+
+    // Ties: U = 14 of 16 with tie correction
+    test = mann_whitney(series_of({{1, 2}, {2, 2}}), series_of({{2, 2}, {3, 2}}));
+    CHECK(fabs(test.effect - 0.875) < 1e-12);
+    CHECK(fabs(test.z - 1.8708286934) < 1e-9);
+    CHECK(fabs(test.p_value - 0.0306844146) < 1e-9);
+
+    // Identical distributions show no effect; an improvement is not significant one-sided
+    test = mann_whitney(series_of({{5, 100}, {6, 50}}), series_of({{5, 100}, {6, 50}}));
+    CHECK(fabs(test.effect - 0.5) < 1e-12 && fabs(test.p_value - 0.5) < 1e-9);
+    test = mann_whitney(series_of({{4, 1}, {5, 1}, {6, 1}}), series_of({{1, 1}, {2, 1}, {3, 1}}));
+    CHECK(test.effect == 0.0 && test.p_value > 0.9);
+}
+
+static void test_tail_blow_up() {
+    // 2% of the candidate jumps from ~110 us to 2500 us; the bulk is unchanged
+    const BenchSeries baseline = series_of({{100, 1000}, {105, 900}, {110, 80}, {112, 20}});
+    const BenchSeries candidate = series_of({{100, 1000}, {105, 880}, {110, 60}, {112, 20}, {2500, 40}});
+    CHECK(series_percentile_us(baseline, 0.99) == 111.0);
+    CHECK(series_percentile_us(candidate, 0.99) == 2500.5);
+
+    // The rank test hardly notices, the tail test does
+    const MannWhitney ranks = mann_whitney(baseline, candidate);
+    CHECK(ranks.p_value > 0.01);
+    const TailTest tail = tail_test(baseline, candidate);
+    CHECK(tail.bucket == 110);
+    CHECK(fabs(tail.baseline_share - 0.01) < 1e-12 && fabs(tail.candidate_share - 0.03) < 1e-12);
+    // z = 0.02 / sqrt(0.02 * 0.98 * (2 / 2000))
+    CHECK(fabs(tail.z - 0.02 / sqrt(0.02 * 0.98 * 0.001)) < 1e-9);
+    CHECK(tail.p_value < 1e-4);
+
+    // No change, or a lighter tail, is not significant
+    CHECK(fabs(tail_test(baseline, baseline).p_value - 0.5) < 1e-12);
+    CHECK(tail_test(candidate, baseline).p_value > 0.5);
+    CHECK(tail_test(baseline, BenchSeries()).p_value == 1.0);
+}
+
+static void test_json_round_trip() {
+    BenchResults results;
+    results.host = bench_host_info();
+    results.timestamp = bench_timestamp();
+    results.command = "spsc_bench latency --json \"out.json\"";
+    results.series.push_back(series_of({{3, 10}, {4, 2}, {90, 1}}));
+    results.series.back().name = "latency/hybrid";
+    results.series.back().count = 13;
+
+    char path[] = "/tmp/spsc_test_results.XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+    CHECK(results_write_json(path, results));
+    BenchResults read_back;
+    CHECK(results_read_json(path, read_back));
+    unlink(path);
+
+    CHECK(read_back.command == results.command && read_back.host.hostname == results.host.hostname);
+    CHECK(read_back.series.size() == 1 && read_back.series[0].name == "latency/hybrid");
+    CHECK(read_back.series[0].count == 13 && read_back.series[0].buckets == results.series[0].buckets);
+}
+
+int main() {
+    test_mann_whitney();
+    test_tail_blow_up();
+    test_json_round_trip();
+    return check_report();
+}
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "check.h"
+#include "udp_bridge.h"
+
+/*
+ * Tests for the UDP bridge's sequence and loss accounting, over loopback.
+ */
+
+using Sender = BridgeSender<Message>;
+using Receiver = BridgeReceiver<Message>;
+using LocalRing = BasicRing<Sample<Message>, uint32_t, 64>;
+
+/**
+ * @brief Opens a receiver on an ephemeral loopback port and a sender connected to it
+ */
+static bool open_pair(Sender &sender, Receiver &receiver) {
+    if (!bridge_receiver_open(receiver, "127.0.0.1", 0, 20))
+        return false;
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    if (getsockname(receiver.fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0)
+        return false;
+    return bridge_sender_open(sender, "127.0.0.1", ntohs(addr.sin_port));
+}
+
+static void send_samples(Sender &sender, ExportRing &ring, uint64_t first, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        Sample<Message> sample{};
+        sample.cycle = first + i;
+        try_push(ring, sample);
+    }
+    while (ring_occupancy(ring) > 0)
+        bridge_send(sender, ring);
+}
+
+/**
+ * @brief Receives until the socket stays quiet for one timeout
+ * @return Number of datagrams received
+ */
+static size_t receive_all(Receiver &receiver, LocalRing &ring) {
+    size_t datagrams = 0;
+    ssize_t n;
+    while ((n = bridge_receive(receiver, ring)) > 0)
+        datagrams += static_cast<size_t>(n);
+    return datagrams;
+}
+
+static size_t pop_all(LocalRing &ring) {
+    size_t count = 0;
+    Sample<Message> sample;
+    while (try_pop(ring, sample))
+        count += 1;
+    return count;
+}
+
+static void test_sequence_accounting() {
+    static Sender sender;
+    static Receiver receiver;
+    static ExportRing export_ring;
+    static LocalRing local;
+    CHECK(open_pair(sender, receiver));
+
+    // A receiver that joins a running sender starts counting at the first datagram it sees
+    sender.sequence = 5000;
+    send_samples(sender, export_ring, 0, 10);
+    CHECK(receive_all(receiver, local) == 1);
+    CHECK(receiver.received == 10 && receiver.lost == 0 && receiver.expected == 5010);
+    CHECK(pop_all(local) == 10);
+
+    // A gap in the sequence is booked as lost samples
+    sender.sequence += 7;
+    send_samples(sender, export_ring, 10, 10);
+    receive_all(receiver, local);
+    CHECK(receiver.received == 20 && receiver.lost == 7);
+    CHECK(pop_all(local) == 10);
+
+    // A datagram from before the expected sequence is stale and not delivered
+    sender.sequence = 5005;
+    send_samples(sender, export_ring, 20, 3);
+    receive_all(receiver, local);
+    CHECK(receiver.stale == 1 && receiver.received == 20 && receiver.lost == 7);
+    CHECK(pop_all(local) == 0);
+
+    bridge_close(sender);
+    bridge_close(receiver);
+}
+
+static void test_full_ring_is_not_quiet() {
+    static Sender sender;
+    static Receiver receiver;
+    static ExportRing export_ring;
+    static LocalRing local;
+    CHECK(open_pair(sender, receiver));
+
+    // Everything arrives, but only what fits into the local ring is pushed
+    const size_t total = 3 * Sender::per_datagram;
+    send_samples(sender, export_ring, 0, total);
+    CHECK(receive_all(receiver, local) == 3);
+    CHECK(receiver.received == total && receiver.lost == 0);
+    CHECK(receiver.overflows == total - 64);
+    CHECK(pop_all(local) == 64);
+
+    // Nothing queued: the receive times out
+    CHECK(bridge_receive(receiver, local) == 0);
+
+    bridge_close(sender);
+    bridge_close(receiver);
+}
+
+int main() {
+    test_sequence_accounting();
+    test_full_ring_is_not_quiet();
+    return check_report();
+}
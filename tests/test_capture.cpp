@@ -0,0 +1,72 @@
+#include <math.h>
+#include <stdint.h>
+
+#include "capture.h"
+#include "check.h"
+
+/*
+ * Tests for the RT-side triggered capture.
+ */
+
+static void test_threshold_settings() {
+    static TriggeredCapture<Message, 4, 4> capture;
+    CHECK(!capture_set_threshold(capture, Message::axes, 1.0f, 0.1f));
+    CHECK(!capture_set_threshold(capture, 0, 1.0f, -0.1f));
+    CHECK(!capture_set_threshold(capture, 0, NAN, 0.1f));
+    CHECK(!capture.threshold_enabled);
+    CHECK(capture_set_threshold(capture, Message::axes - 1, 1.0f, 0.1f));
+    CHECK(capture.threshold_enabled && capture.threshold_axis == Message::axes - 1);
+
+    // An out-of-range axis set by hand never indexes past the message
+    capture.threshold_axis = 1000;
+    Sample<Message> sample{};
+    for (uint64_t i = 0; i < 10; ++i) {
+        sample.cycle = i;
+        capture_record(capture, sample, false);
+    }
+    CHECK(capture_ready(capture) == nullptr);
+}
+
+static void test_edge_trigger() {
+    static TriggeredCapture<Message, 4, 4> capture;
+    CHECK(capture_set_threshold(capture, 0, 1.0f, 0.25f));
+
+    // One long excursion, a wobble inside the hysteresis band, then a second excursion
+    const float levels[] = {0.0f, 0.0f, 0.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f,
+                            0.9f, 1.5f, 0.9f, 1.5f, 0.5f, 0.5f, 0.5f, 0.5f, 1.5f, 1.5f};
+    int completed = 0;
+    uint64_t trigger_cycle = 0;
+    size_t pre_count = 0;
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); ++i) {
+        Sample<Message> sample{};
+        sample.cycle = i;
+        sample.msg.arrayOfNumbers[0] = levels[i];
+        capture_record(capture, sample, false);
+        if (const auto *buffer = capture_ready(capture)) {
+            trigger_cycle = buffer->trigger_cycle;
+            pre_count = buffer->pre_count;
+            completed += 1;
+            capture_release(capture);
+        }
+    }
+    CHECK(completed == 1);
+    CHECK(trigger_cycle == 3 && pre_count == 3);
+    CHECK(capture.missed_triggers == 0);
+
+    // The second excursion completes once its post-trigger samples are in
+    for (uint64_t i = 21; i < 25; ++i) {
+        Sample<Message> sample{};
+        sample.cycle = i;
+        sample.msg.arrayOfNumbers[0] = 1.5f;
+        capture_record(capture, sample, false);
+    }
+    const auto *buffer = capture_ready(capture);
+    CHECK(buffer != nullptr && buffer->trigger_cycle == 19 && buffer->source == TRIGGER_THRESHOLD);
+    CHECK(buffer != nullptr && buffer->pre_count == 4 && buffer->samples[0].cycle == 15);
+}
+
+int main() {
+    test_threshold_settings();
+    test_edge_trigger();
+    return check_report();
+}
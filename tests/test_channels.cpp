@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "check.h"
+#include "spsc.h"
+
+/*
+ * Tests for channels placed in caller-provided and POSIX shm memory.
+ */
+
+using SmallRing = BasicRing<uint32_t, uint32_t, 16>;
+
+static void test_create_at_validation() {
+    alignas(64) static uint8_t arena[2 * sizeof(SmallRing) + 64];
+
+    CHECK(channel_create_at<SmallRing>(nullptr, sizeof(arena)) == nullptr);
+    CHECK(channel_create_at<SmallRing>(arena, sizeof(SmallRing) - 1) == nullptr);
+    CHECK(channel_create_at<SmallRing>(arena + 8, sizeof(SmallRing)) == nullptr);
+    CHECK(channel_attach<SmallRing>(arena + 1, sizeof(SmallRing)) == nullptr);
+
+    // Construction resets whatever was in the region
+    memset(arena, 0xab, sizeof(arena));
+    SmallRing *ring = channel_create_at<SmallRing>(arena, sizeof(arena));
+    CHECK(ring == reinterpret_cast<SmallRing *>(arena));
+    CHECK(ring != nullptr && ring_occupancy(*ring) == 0);
+
+    // Attaching leaves the contents alone, so both views see the same queue
+    CHECK(try_push(*ring, 42u));
+    SmallRing *same = channel_attach<SmallRing>(arena, sizeof(SmallRing));
+    uint32_t value = 0;
+    CHECK(same != nullptr && try_pop(*same, value) && value == 42);
+
+    alignas(64) static uint8_t box_memory[sizeof(Mailbox)];
+    Mailbox *mailbox = channel_create_at<Mailbox>(box_memory, sizeof(box_memory));
+    CHECK(mailbox != nullptr);
+    Message command = {};
+    command.arrayOfNumbers[3] = 3.5f;
+    send_command(*mailbox, command);
+    CHECK(peek(*channel_attach<Mailbox>(box_memory, sizeof(box_memory))).arrayOfNumbers[3] == 3.5f);
+}
+
+static void test_shm_channel() {
+    char name[64];
+    snprintf(name, sizeof(name), "/spsc_test_%d", static_cast<int>(getpid()));
+
+    CHECK(shm_channel_attach<SmallRing>(name) == nullptr);
+    SmallRing *producer = shm_channel_create<SmallRing>(name);
+    CHECK(producer != nullptr);
+    if (producer == nullptr)
+        return;
+
+    // A second mapping of the object, as another process would have
+    SmallRing *consumer = shm_channel_attach<SmallRing>(name);
+    CHECK(consumer != nullptr && consumer != producer);
+    if (consumer != nullptr) {
+        for (uint32_t i = 0; i < 40; ++i) {
+            CHECK(try_push(*producer, i));
+            uint32_t value = UINT32_MAX;
+            CHECK(try_pop(*consumer, value) && value == i);
+        }
+        shm_channel_detach(consumer);
+    }
+
+    // An object of another size is refused
+    CHECK(shm_channel_attach<BasicRing<uint32_t, uint32_t, 32>>(name) == nullptr);
+
+    shm_channel_detach(producer, name);
+    CHECK(shm_channel_attach<SmallRing>(name) == nullptr);
+}
+
+int main() {
+    test_create_at_validation();
+    test_shm_channel();
+    return check_report();
+}
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "check.h"
+#include "deadband.h"
+#include "spsc.h"
+
+/*
+ * Tests for send-on-delta telemetry: the RT-side decision, keep-alives,
+ * retrying after a failed push, and reconstruction on the Observer side.
+ */
+
+// Five axes: four go through the SSE2 comparison and one through the scalar tail
+using Msg = BasicMessage<5>;
+
+static void test_decisions() {
+    DeadbandFilter<Msg> filter;
+    deadband_init(filter, 0.5f, 10);
+    Msg message = {};
+    message.keepRunning = true;
+
+    CHECK(deadband_should_send(filter, message, 1));
+    deadband_commit(filter, message, 1);
+    CHECK(!deadband_should_send(filter, message, 2));
+
+    message.arrayOfNumbers[2] = 0.4f;
+    CHECK(!deadband_should_send(filter, message, 3));
+    message.arrayOfNumbers[2] = 0.6f;
+    CHECK(deadband_should_send(filter, message, 3));
+
+    // Until it is committed, the change keeps being reported
+    CHECK(deadband_should_send(filter, message, 4));
+    deadband_commit(filter, message, 4);
+    CHECK(!deadband_should_send(filter, message, 5));
+
+    CHECK(!deadband_should_send(filter, message, 13));
+    CHECK(deadband_should_send(filter, message, 14)); // keep-alive
+
+    message.keepRunning = false;
+    CHECK(deadband_should_send(filter, message, 5));
+    message.keepRunning = true;
+
+    // NaN appearing or disappearing is a change, in a vector lane and in the scalar tail
+    for (size_t axis : {size_t(1), size_t(4)}) {
+        message.arrayOfNumbers[axis] = NAN;
+        CHECK(deadband_should_send(filter, message, 6));
+        deadband_commit(filter, message, 6);
+        CHECK(!deadband_should_send(filter, message, 7));
+        message.arrayOfNumbers[axis] = 0.0f;
+        CHECK(deadband_should_send(filter, message, 7));
+        deadband_commit(filter, message, 7);
+    }
+}
+
+static void test_stream_with_full_ring() {
+    DeadbandFilter<Msg> filter;
+    deadband_init(filter, 0.5f, 1000);
+    static BasicRing<Sample<Msg>, uint32_t, 4> ring;
+    DeadbandReconstructor<Msg> rebuild;
+
+    std::vector<float> truth;
+    std::vector<Sample<Msg>> rebuilt;
+    uint64_t dropped = 0;
+    for (uint64_t cycle = 1; cycle <= 60; ++cycle) {
+        // Toggles beyond the band every cycle, then jumps to 5 while the Observer is stalled
+        Msg message = {};
+        message.keepRunning = true;
+        message.arrayOfNumbers[0] = cycle < 20 ? static_cast<float>(cycle % 2) : 5.0f;
+        truth.push_back(message.arrayOfNumbers[0]);
+
+        Sample<Msg> sample{};
+        sample.cycle = cycle;
+        sample.msg = message;
+        if (deadband_should_send(filter, message, cycle)) {
+            if (try_push(ring, sample))
+                deadband_commit(filter, message, cycle);
+            else
+                dropped += 1;
+        }
+
+        const bool stalled = cycle >= 10 && cycle < 30;
+        Sample<Msg> received;
+        while (!stalled && try_pop(ring, received))
+            deadband_reconstruct(rebuild, received, [&rebuilt](const Sample<Msg> &s) { rebuilt.push_back(s); });
+    }
+
+    CHECK(dropped > 0);
+    // One reconstructed sample per cycle, in order
+    bool contiguous = !rebuilt.empty() && rebuilt.front().cycle == 1;
+    for (size_t i = 1; i < rebuilt.size(); ++i)
+        contiguous = contiguous && rebuilt[i].cycle == rebuilt[i - 1].cycle + 1;
+    CHECK(contiguous);
+
+    // The jump was resent as soon as the ring had room, long before the keep-alive
+    CHECK(rebuilt.size() >= 30);
+    CHECK(rebuilt.back().msg.arrayOfNumbers[0] == 5.0f);
+    bool within_band = true;
+    for (const Sample<Msg> &s : rebuilt) {
+        if (s.cycle < 10 || s.cycle > 30)
+            within_band = within_band && fabsf(s.msg.arrayOfNumbers[0] - truth[s.cycle - 1]) <= 0.5f;
+    }
+    CHECK(within_band);
+}
+
+static void test_reconstruct_gaps() {
+    DeadbandReconstructor<Msg> rebuild;
+    std::vector<Sample<Msg>> out;
+    auto collect = [&out](const Sample<Msg> &s) { out.push_back(s); };
+
+    Sample<Msg> sample{};
+    sample.cycle = 5;
+    sample.msg.arrayOfNumbers[0] = 1.0f;
+    deadband_reconstruct(rebuild, sample, collect);
+    sample.cycle = 9;
+    sample.msg.arrayOfNumbers[0] = 2.0f;
+    deadband_reconstruct(rebuild, sample, collect);
+
+    CHECK(out.size() == 5);
+    CHECK(out[0].cycle == 5 && out[1].cycle == 6 && out[3].cycle == 8 && out[4].cycle == 9);
+    CHECK(out[3].msg.arrayOfNumbers[0] == 1.0f && out[4].msg.arrayOfNumbers[0] == 2.0f);
+}
+
+int main() {
+    test_decisions();
+    test_stream_with_full_ring();
+    test_reconstruct_gaps();
+    return check_report();
+}
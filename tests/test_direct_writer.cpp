@@ -0,0 +1,69 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "direct_writer.h"
+
+/*
+ * Tests for the asynchronous direct writer on both of its backends.
+ */
+
+/**
+ * @brief Appends about 3.5 buffers' worth of bytes in uneven pieces and checks the file byte for byte
+ */
+static void write_and_compare(const std::string &path, bool allow_io_uring, int expected_backend) {
+    const size_t buffer_bytes = 2 * DIRECT_ALIGNMENT;
+    std::vector<uint8_t> expected(7 * DIRECT_ALIGNMENT + 1234);
+    for (size_t i = 0; i < expected.size(); ++i)
+        expected[i] = static_cast<uint8_t>(i * 131 + i / 4096);
+
+    DirectWriter writer;
+    CHECK(direct_writer_open(writer, path.c_str(), buffer_bytes, 3, allow_io_uring));
+    CHECK(writer.backend == expected_backend);
+    bool appended = true;
+    for (size_t done = 0, piece = 1; done < expected.size(); piece = piece * 7 % 5003 + 1) {
+        const size_t n = piece < expected.size() - done ? piece : expected.size() - done;
+        appended = appended && direct_writer_append(writer, expected.data() + done, n);
+        done += n;
+    }
+    CHECK(appended);
+    CHECK(direct_writer_committed(writer) <= expected.size());
+    CHECK(direct_writer_close(writer));
+
+    std::vector<uint8_t> actual(expected.size() + 1);
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    CHECK(fd >= 0);
+    CHECK(read(fd, actual.data(), actual.size()) == static_cast<ssize_t>(expected.size()));
+    close(fd);
+    actual.resize(expected.size());
+    CHECK(actual == expected);
+}
+
+static void test_thread_pool(const std::string &dir) {
+    write_and_compare(dir + "/pool.bin", false, DIRECT_BACKEND_THREAD_POOL);
+}
+
+static void test_io_uring(const std::string &dir) {
+    // Kernels or sandboxes without io_uring fall back to the pool, which is covered above
+    IoUring ring;
+    const bool available = io_uring_init(ring, 2) && io_uring_supports_write(ring);
+    io_uring_exit(ring);
+    if (!available) {
+        printf("io_uring not available, skipping its test\n");
+        return;
+    }
+    write_and_compare(dir + "/uring.bin", true, DIRECT_BACKEND_IO_URING);
+}
+
+int main() {
+    const std::string dir = check_temp_dir();
+    test_thread_pool(dir);
+    test_io_uring(dir);
+    check_remove_dir(dir);
+    return check_report();
+}
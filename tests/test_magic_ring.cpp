@@ -0,0 +1,151 @@
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "check.h"
+#include "command_log.h"
+#include "magic_ring.h"
+
+/*
+ * Tests for the double-mapped MagicRing and the command log built on it.
+ */
+
+static void test_rejects_bad_capacity() {
+    MagicRing ring;
+    CHECK(!magic_ring_create(ring, 0));
+    CHECK(!magic_ring_create(ring, 3 * 4096));
+    CHECK(!magic_ring_create(ring, 64));
+}
+
+static void test_record_across_wrap() {
+    MagicRing ring;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    CHECK(magic_ring_create(ring, page));
+
+    // Move the indices so the next record straddles the end of the first mapping
+    std::vector<uint8_t> filler(page - 100, 0xee);
+    CHECK(magic_ring_try_push(ring, filler.data(), filler.size()));
+    size_t len;
+    magic_ring_readable(ring, len);
+    CHECK(len == filler.size());
+    magic_ring_release(ring, len);
+
+    std::vector<uint8_t> record(300);
+    for (size_t i = 0; i < record.size(); ++i)
+        record[i] = static_cast<uint8_t>(i * 7 + 1);
+    uint8_t *span = magic_ring_reserve(ring, record.size());
+    CHECK(span != nullptr && span + record.size() > ring.base + ring.capacity);
+    CHECK(magic_ring_try_push(ring, record.data(), record.size()));
+
+    // The record reads back as one span, and the second mapping aliases the first
+    const uint8_t *readable = magic_ring_readable(ring, len);
+    CHECK(len == record.size());
+    CHECK(memcmp(readable, record.data(), record.size()) == 0);
+    CHECK(memcmp(ring.base, record.data() + 100, record.size() - 100) == 0);
+    magic_ring_release(ring, len);
+
+    // Full and empty
+    std::vector<uint8_t> big(page, 1);
+    CHECK(magic_ring_try_push(ring, big.data(), big.size()));
+    CHECK(!magic_ring_try_push(ring, big.data(), 1));
+    magic_ring_readable(ring, len);
+    CHECK(len == page);
+    magic_ring_release(ring, len);
+    magic_ring_readable(ring, len);
+    CHECK(len == 0);
+
+    magic_ring_destroy(ring);
+    CHECK(ring.base == nullptr && ring.fd < 0);
+}
+
+static void test_drain_across_wrap() {
+    MagicRing ring;
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    CHECK(magic_ring_create(ring, page));
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+
+    // Stream counting bytes through the ring in odd-sized pieces, wrapping several times
+    std::vector<uint8_t> received;
+    uint8_t next = 0;
+    bool ok = true;
+    for (int round = 0; round < 40; ++round) {
+        uint8_t piece[333];
+        for (auto &b : piece)
+            b = next++;
+        ok = ok && magic_ring_try_push(ring, piece, sizeof(piece));
+        const ssize_t drained = magic_ring_drain_to_fd(ring, fds[1], page);
+        ok = ok && drained == static_cast<ssize_t>(sizeof(piece));
+        uint8_t back[sizeof(piece)];
+        ok = ok && read(fds[0], back, sizeof(back)) == static_cast<ssize_t>(sizeof(back));
+        received.insert(received.end(), back, back + sizeof(back));
+    }
+    CHECK(ok);
+    bool in_order = true;
+    for (size_t i = 0; i < received.size(); ++i)
+        in_order = in_order && received[i] == static_cast<uint8_t>(i);
+    CHECK(in_order);
+    CHECK(magic_ring_drain_to_fd(ring, fds[1], page) == 0);
+
+    close(fds[0]);
+    close(fds[1]);
+    magic_ring_destroy(ring);
+}
+
+static void test_command_log_stream() {
+    using Msg = BasicMessage<2>;
+    static CommandLog<Msg> log;
+    CHECK(command_log_init(log));
+    static BasicMailbox<Msg> mailbox;
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+
+    // More records than fit in the ring at once, drained as they go so they wrap
+    const size_t total = 3 * log.ring.capacity / sizeof(CommandRecord<Msg>);
+    Msg command = {};
+    std::vector<CommandRecord<Msg>> read_back;
+    for (size_t i = 0; i < total; ++i) {
+        command.arrayOfNumbers[0] = static_cast<float>(i);
+        send_command(mailbox, command);
+        command_log_peek(log, mailbox, 10 + i);
+        command_log_peek(log, mailbox, 11 + i); // unchanged: not logged again
+        if (i % 16 == 15 || i + 1 == total) {
+            CHECK(command_log_drain(log, fds[1]));
+            size_t pending = i + 1 - read_back.size();
+            std::vector<CommandRecord<Msg>> records(pending);
+            CHECK(read(fds[0], records.data(), pending * sizeof(records[0]))
+                  == static_cast<ssize_t>(pending * sizeof(records[0])));
+            read_back.insert(read_back.end(), records.begin(), records.end());
+        }
+    }
+    CHECK(read_back.size() == total);
+    bool in_order = true;
+    for (size_t i = 0; i < read_back.size(); ++i) {
+        in_order = in_order && read_back[i].cycle == 10 + i && read_back[i].sequence == i + 1
+                && read_back[i].command.arrayOfNumbers[0] == static_cast<float>(i);
+    }
+    CHECK(in_order);
+    CHECK(log.overflows.load() == 0);
+
+    // Without a drain the ring fills up and further commands count as overflows
+    const size_t fit = log.ring.capacity / sizeof(CommandRecord<Msg>);
+    for (size_t i = 0; i < fit + 5; ++i) {
+        command.arrayOfNumbers[1] = static_cast<float>(i);
+        send_command(mailbox, command);
+        command_log_peek(log, mailbox, 1000 + i);
+    }
+    CHECK(log.overflows.load() == 5);
+
+    close(fds[0]);
+    close(fds[1]);
+    command_log_destroy(log);
+}
+
+int main() {
+    test_rejects_bad_capacity();
+    test_record_across_wrap();
+    test_drain_across_wrap();
+    test_command_log_stream();
+    return check_report();
+}
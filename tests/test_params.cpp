@@ -0,0 +1,88 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+
+#include "check.h"
+#include "params.h"
+
+/*
+ * Tests for the parameter table: probing, key and handle validation, torn-read freedom.
+ */
+
+// Two values a torn read could mix up
+struct ParamPair {
+    double value;
+    double negated;
+};
+
+static void test_probing_and_validation() {
+    static ParamTable<double, 16> table;
+    ParamHandle handles[16];
+    char key[PARAM_KEY_LENGTH];
+    // Filling the table forces collisions, so lookups must follow the probe chains
+    for (int i = 0; i < 16; ++i) {
+        snprintf(key, sizeof(key), "gain.%d", i);
+        CHECK(param_define(table, key, static_cast<double>(i), handles[i]));
+    }
+    CHECK(table.count == 16);
+    CHECK(!param_define(table, "one.too.many", 0.0, handles[0]));
+    bool found = true, values = true;
+    for (int i = 0; i < 16; ++i) {
+        snprintf(key, sizeof(key), "gain.%d", i);
+        found = found && param_find(table, key).slot == handles[i].slot;
+        values = values && param_get(table, handles[i]) == static_cast<double>(i);
+    }
+    CHECK(found);
+    CHECK(values);
+
+    // Redefining keeps the value; unknown and overlong keys are rejected
+    ParamHandle again;
+    CHECK(param_define(table, "gain.3", 99.0, again) && again.slot == handles[3].slot);
+    CHECK(param_get(table, again) == 3.0);
+    CHECK(!param_valid(param_find(table, "missing")));
+    CHECK(!param_define(table, "a.key.that.is.much.too.long.to.fit", 1.0, again));
+    CHECK(!param_define(table, "", 1.0, again));
+
+    CHECK(param_set(table, "gain.5", 5.5));
+    CHECK(param_get(table, handles[5]) == 5.5);
+    CHECK(!param_set(table, "missing", 1.0));
+
+    // Invalid handles are refused instead of indexing out of bounds
+    ParamHandle invalid;
+    double value = 1.0;
+    CHECK(!param_set(table, invalid, 2.0));
+    CHECK(!param_try_get(table, invalid, value) && value == 1.0);
+    CHECK(param_get(table, invalid) == 0.0);
+}
+
+static void test_no_torn_reads() {
+    // A reader racing the writer only ever sees whole values
+    static ParamTable<ParamPair, 4> pairs;
+    ParamHandle pair;
+    CHECK(param_define(pairs, "pair", ParamPair{0.0, -0.0}, pair));
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (int i = 1; i <= 200000; ++i) {
+            param_set(pairs, pair, ParamPair{static_cast<double>(i), -static_cast<double>(i)});
+            if (i % 1000 == 0)
+                std::this_thread::yield();
+        }
+        done.store(true, std::memory_order_release);
+    });
+    uint64_t torn = 0;
+    while (!done.load(std::memory_order_acquire)) {
+        ParamPair read;
+        if (param_try_get(pairs, pair, read) && read.value != -read.negated)
+            torn += 1;
+    }
+    writer.join();
+    CHECK(torn == 0);
+    CHECK(param_get(pairs, pair).value == 200000.0);
+}
+
+int main() {
+    test_probing_and_validation();
+    test_no_torn_reads();
+    return check_report();
+}
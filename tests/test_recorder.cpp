@@ -0,0 +1,227 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "recorder.h"
+#include "recording_reader.h"
+
+/*
+ * Tests for the chunked recorder and the indexed reader.
+ */
+
+static Sample<Message> make_sample(uint64_t i) {
+    Sample<Message> sample{};
+    sample.cycle = i;
+    sample.time_ns = 1000000 + static_cast<int64_t>(i) * 1000;
+    for (size_t a = 0; a < Message::axes; ++a)
+        sample.msg.arrayOfNumbers[a] = static_cast<float>(i % 97) + static_cast<float>(a);
+    return sample;
+}
+
+static void test_round_trip_and_seek(const std::string &dir) {
+    const std::string path = dir + "/round.rec";
+    Recorder recorder;
+    CHECK(recorder_open(recorder, path.c_str(), Message::axes, VALUE_F32, 500));
+    bool appended = true;
+    for (uint64_t i = 0; i < 10000; ++i)
+        appended = appended && recorder_append_sample(recorder, make_sample(i));
+    CHECK(appended);
+    CHECK(recorder_close(recorder));
+
+    RecordingReader reader;
+    CHECK(reader_open(reader, path.c_str()));
+    CHECK(reader.index.size() == 20);
+
+    // Seek to a timestamp in the middle of chunk 7 and find its record
+    const int64_t target = make_sample(3721).time_ns;
+    const size_t chunk = reader_seek(reader, target);
+    CHECK(chunk == 7);
+    ChunkView view;
+    CHECK(reader_map_chunk(reader, chunk, view));
+    const size_t r = chunk_lower_bound(view, target);
+    const RecordPrefix prefix = chunk_record_prefix(view, r);
+    CHECK(prefix.cycle == 3721 && prefix.time_ns == target);
+    float values[Message::axes];
+    memcpy(values, chunk_record_values(view, r), sizeof(values));
+    CHECK(values[0] == make_sample(3721).msg.arrayOfNumbers[0] && values[7] == make_sample(3721).msg.arrayOfNumbers[7]);
+    reader_unmap_chunk(view);
+    reader_close(reader);
+}
+
+static void test_failed_write_latches(const std::string &dir) {
+    const std::string path = dir + "/failing.rec";
+    Recorder recorder;
+    CHECK(recorder_open(recorder, path.c_str(), Message::axes, VALUE_F32, 16));
+    for (uint64_t i = 0; i < 20; ++i)
+        CHECK(recorder_append_sample(recorder, make_sample(i)));
+
+    // From now on every data write fails with ENOSPC
+    int full = open("/dev/full", O_WRONLY | O_CLOEXEC);
+    CHECK(full >= 0 && dup2(full, recorder.fd) == recorder.fd);
+    close(full);
+
+    size_t failures = 0;
+    bool bounded = true;
+    for (uint64_t i = 20; i < 100; ++i) {
+        failures += !recorder_append_sample(recorder, make_sample(i));
+        bounded = bounded && recorder.chunk_count < recorder.chunk_records;
+    }
+    CHECK(bounded);
+    CHECK(recorder.failed);
+    CHECK(failures == 100 - 32 + 1); // the append that filled chunk two, and everything after it
+    CHECK(!recorder_flush(recorder));
+    CHECK(!recorder_close(recorder));
+    CHECK(recorder.fd < 0 && recorder.index_fd < 0);
+
+    // The first chunk made it, so the recording stays readable up to there
+    RecordingReader reader;
+    CHECK(reader_open(reader, path.c_str()));
+    CHECK(reader.index.size() == 1);
+    reader_close(reader);
+}
+
+static void test_open_cleans_up(const std::string &dir) {
+    // An index file that takes no data makes the header write fail after both files were opened
+    const std::string path = dir + "/noindex.rec";
+    CHECK(symlink("/dev/full", (path + ".idx").c_str()) == 0);
+
+    Recorder recorder;
+    CHECK(!recorder_open(recorder, path.c_str(), Message::axes, VALUE_F32));
+    CHECK(recorder.fd < 0 && recorder.index_fd < 0);
+
+    DirectWriter writer;
+    Recorder direct;
+    CHECK(!recorder_open_direct(direct, writer, path.c_str(), Message::axes, VALUE_F32));
+    CHECK(direct.direct == nullptr);
+    CHECK(direct.fd < 0 && direct.index_fd < 0);
+    CHECK(writer.fd < 0);
+}
+
+static void test_chunk_codec() {
+    // Slowly changing records, like telemetry: mostly zero after the XOR
+    const size_t record_size = sizeof(RecordPrefix) + 8 * sizeof(float);
+    const size_t records = 1000;
+    std::vector<uint8_t> raw(records * record_size);
+    for (size_t r = 0; r < records; ++r) {
+        RecordPrefix prefix = {};
+        prefix.cycle = r;
+        prefix.time_ns = static_cast<int64_t>(r) * 2000000;
+        memcpy(&raw[r * record_size], &prefix, sizeof(prefix));
+        for (size_t a = 0; a < 8; ++a) {
+            const float value = a < 4 ? static_cast<float>(a) : static_cast<float>(r / 50 + a);
+            memcpy(&raw[r * record_size + sizeof(prefix) + a * sizeof(float)], &value, sizeof(value));
+        }
+    }
+    std::vector<uint8_t> encoded;
+    chunk_encode(raw.data(), raw.size(), record_size, encoded);
+    CHECK(encoded.size() < raw.size() / 2);
+    std::vector<uint8_t> decoded(raw.size());
+    CHECK(chunk_decode(encoded.data(), encoded.size(), record_size, decoded.data(), decoded.size()));
+    CHECK(decoded == raw);
+
+    // Incompressible bytes and long zero runs at both ends
+    std::mt19937 rng(7);
+    std::vector<uint8_t> noise(4096 + 300, 0);
+    for (size_t i = 300; i < 4096; ++i)
+        noise[i] = static_cast<uint8_t>(rng());
+    chunk_encode(noise.data(), noise.size(), 16, encoded);
+    decoded.assign(noise.size(), 0xff);
+    CHECK(chunk_decode(encoded.data(), encoded.size(), 16, decoded.data(), decoded.size()));
+    CHECK(decoded == noise);
+
+    // A truncated payload or a wrong expected size is rejected
+    CHECK(!chunk_decode(encoded.data(), encoded.size() - 1, 16, decoded.data(), decoded.size()));
+    CHECK(!chunk_decode(encoded.data(), encoded.size(), 16, decoded.data(), decoded.size() - 1));
+}
+
+static void test_compressed_chunks(const std::string &dir) {
+    const std::string path = dir + "/compressed.rec";
+    Recorder recorder;
+    CHECK(recorder_open(recorder, path.c_str(), Message::axes, VALUE_F32, 100, true));
+    for (uint64_t i = 0; i < 1000; ++i)
+        recorder_append_sample(recorder, make_sample(i));
+    CHECK(recorder_close(recorder));
+
+    RecordingReader reader;
+    CHECK(reader_open(reader, path.c_str()));
+    CHECK(reader.index.size() == 10);
+    ChunkView view;
+    CHECK(reader_map_chunk(reader, 4, view));
+    CHECK(view.count == 100 && chunk_record_prefix(view, 50).cycle == 450);
+    reader_unmap_chunk(view);
+
+    // A payload that ends early cannot be decoded, and the chunk is reported instead of mapped
+    reader.index[9].payload_bytes -= 1;
+    CHECK(!reader_map_chunk(reader, 9, view));
+    reader_unmap_chunk(view);
+    reader_close(reader);
+}
+
+static void test_live_follow(const std::string &dir) {
+    const std::string name = "/spsc_test_live_" + std::to_string(getpid());
+    LiveHeader *live = live_create(name.c_str());
+    CHECK(live != nullptr);
+    const LiveHeader *viewer = live_attach(name.c_str());
+    CHECK(viewer != nullptr);
+
+    const std::string path = dir + "/live.rec";
+    Recorder recorder;
+    recorder.live = live;
+    CHECK(recorder_open(recorder, path.c_str(), Message::axes, VALUE_F32, 100));
+    const LiveFile file = live_read_file(*viewer);
+    CHECK(path == file.path && file.generation == 2);
+    CHECK(file.record_size == sizeof(RecordPrefix) + Message::axes * sizeof(float));
+
+    // Two full chunks are committed; the half-filled third one is not announced yet
+    for (uint64_t i = 0; i < 250; ++i)
+        recorder_append_sample(recorder, make_sample(i));
+    const uint64_t committed = viewer->committed_offset.load(std::memory_order_acquire);
+    CHECK(committed == sizeof(RecordingHeader) + 2 * (sizeof(ChunkHeader) + 100 * file.record_size));
+    CHECK(viewer->chunk_count.load() == 2);
+
+    // Walk the committed chunks the way spsc_tail does
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    uint64_t offset = sizeof(RecordingHeader);
+    uint64_t records = 0;
+    ChunkHeader header;
+    while (offset + sizeof(header) <= committed
+           && pread(fd, &header, sizeof(header), static_cast<off_t>(offset)) == sizeof(header)) {
+        const IndexEntry entry = {header.first_time_ns, header.last_time_ns, offset,
+                                  header.payload_bytes, header.count, 0};
+        CHECK(header.magic == CHUNK_MAGIC && chunk_entry_valid(entry, committed, file.record_size));
+        records += header.count;
+        offset += sizeof(header) + header.payload_bytes;
+    }
+    close(fd);
+    CHECK(records == 200 && offset == committed);
+
+    // Chunk headers with a corrupt count or size are rejected before any record is read
+    const uint64_t first = sizeof(RecordingHeader);
+    const uint64_t payload = 100 * file.record_size;
+    CHECK(chunk_entry_valid({0, 0, first, payload, 100, 0}, committed, file.record_size));
+    CHECK(!chunk_entry_valid({0, 0, first, payload, 1000000, 0}, committed, file.record_size));
+    CHECK(!chunk_entry_valid({0, 0, first, committed, 100, 0}, committed, file.record_size));
+    CHECK(!chunk_entry_valid({0, 0, first, 16, 1000000, 1}, committed, file.record_size));
+    CHECK(!chunk_entry_valid({0, 0, committed - 8, 0, 1, 0}, committed, file.record_size));
+
+    CHECK(recorder_close(recorder));
+    CHECK(viewer->closed.load() == 1);
+    live_close(viewer);
+    live_close(live, name.c_str());
+}
+
+int main() {
+    const std::string dir = check_temp_dir();
+    test_chunk_codec();
+    test_compressed_chunks(dir);
+    test_round_trip_and_seek(dir);
+    test_failed_write_latches(dir);
+    test_open_cleans_up(dir);
+    test_live_follow(dir);
+    check_remove_dir(dir);
+    return check_report();
+}
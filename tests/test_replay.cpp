@@ -0,0 +1,130 @@
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "command_log.h"
+#include "rt_logic.h"
+
+/*
+ * Tests for the command log file and for re-executing the RT logic against it.
+ */
+
+using Samples = std::vector<Sample<Message>>;
+
+constexpr int64_t START_NS = 1000000000;
+
+static void drain_samples(Telemetry &rx, Samples &samples, uint64_t &events) {
+    telemetry_drain(rx,
+        [&events](const TelemetryEvent &) { events += 1; },
+        [&samples](const Sample<Message> &sample) { samples.push_back(sample); });
+}
+
+/**
+ * @brief Runs the RT logic like the RT thread does, with the Observer sending a new command every 7 cycles
+ */
+static void run_live(const char *log_path, uint64_t cycles, Samples &samples, uint64_t &events) {
+    static Telemetry channel;
+    static Mailbox mailbox;
+    static CommandLog<Message> log;
+    CHECK(command_log_init(log));
+    const int fd = command_log_create<Message>(log_path);
+    CHECK(fd >= 0);
+
+    Message command = {};
+    command.keepRunning = true;
+    send_command(mailbox, command);
+
+    RtState state;
+    bool running = true;
+    while (running) {
+        if (state.cycle % 7 == 3) {
+            command.arrayOfNumbers[0] = static_cast<float>(state.cycle) * 10.0f;
+            command.keepRunning = state.cycle < cycles;
+            send_command(mailbox, command);
+        }
+        const Message observed = command_log_peek(log, mailbox, state.cycle + 1);
+        running = rt_step(state, observed, START_NS + static_cast<int64_t>(state.cycle) * RT_PERIOD_NS, channel);
+        drain_samples(channel, samples, events);
+        CHECK(command_log_drain(log, fd));
+    }
+    close(fd);
+    CHECK(log.overflows.load() == 0);
+    command_log_destroy(log);
+}
+
+/**
+ * @brief Re-executes the RT logic in virtual time with the commands from a log, like spsc_replay
+ */
+static void run_replay(const std::vector<CommandRecord<Message>> &commands, Samples &samples, uint64_t &events) {
+    static Telemetry channel;
+    RtState state;
+    Message command = {};
+    size_t next_command = 0;
+    bool running = true;
+    while (running) {
+        const uint64_t cycle = state.cycle + 1;
+        while (next_command < commands.size() && commands[next_command].cycle <= cycle)
+            command = commands[next_command++].command;
+        running = rt_step(state, command, START_NS + static_cast<int64_t>(state.cycle) * RT_PERIOD_NS, channel);
+        drain_samples(channel, samples, events);
+    }
+}
+
+static bool same_samples(const Samples &a, const Samples &b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].cycle != b[i].cycle || a[i].subsample != b[i].subsample || a[i].decimation != b[i].decimation
+            || a[i].time_ns != b[i].time_ns
+            || memcmp(a[i].msg.arrayOfNumbers, b[i].msg.arrayOfNumbers, sizeof(a[i].msg.arrayOfNumbers)) != 0)
+            return false;
+    }
+    return true;
+}
+
+static void test_log_round_trip_and_replay(const std::string &dir) {
+    const std::string path = dir + "/commands.log";
+    Samples live, replayed;
+    uint64_t live_events = 0, replayed_events = 0;
+    run_live(path.c_str(), 60, live, live_events);
+
+    // One record per command, stamped with the cycle that first saw it
+    std::vector<CommandRecord<Message>> commands;
+    CHECK(command_log_load(path.c_str(), commands));
+    // The initial command, then one after cycles 3, 10, ..., 66, the last of which stops the loop
+    CHECK(commands.size() == 11);
+    CHECK(commands[0].cycle == 1 && commands[0].sequence == 1);
+    CHECK(commands[1].cycle == 4 && commands[1].command.arrayOfNumbers[0] == 30.0f);
+    CHECK(!commands.back().command.keepRunning && commands.back().cycle == 67);
+
+    // The same inputs produce the same telemetry, down to the last bit
+    run_replay(commands, replayed, replayed_events);
+    CHECK(live.size() == RT_SUBSAMPLES * (commands.back().cycle - 1));
+    CHECK(same_samples(live, replayed));
+    CHECK(live_events == replayed_events);
+
+    // A different command shows up as a divergence from that cycle on
+    commands[3].command.arrayOfNumbers[0] += 1.0f;
+    Samples changed;
+    run_replay(commands, changed, replayed_events);
+    CHECK(!same_samples(live, changed));
+    size_t first_difference = 0;
+    while (first_difference < live.size()
+           && live[first_difference].msg.arrayOfNumbers[0] == changed[first_difference].msg.arrayOfNumbers[0])
+        first_difference += 1;
+    CHECK(first_difference < live.size() && live[first_difference].cycle == commands[3].cycle);
+
+    // A log written for another message type is refused
+    std::vector<CommandRecord<BasicMessage<2>>> other;
+    CHECK(!command_log_load(path.c_str(), other));
+}
+
+int main() {
+    const std::string dir = check_temp_dir();
+    test_log_round_trip_and_replay(dir);
+    check_remove_dir(dir);
+    return check_report();
+}
@@ -0,0 +1,189 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "check.h"
+#include "spsc.h"
+
+/*
+ * Tests for the SPSC rings, drain_to_fd and the mailbox.
+ */
+
+/**
+ * @brief Pushes and pops `total` sequence numbers in uneven batches, checking order and occupancy
+ */
+template <typename RingType>
+static void ring_round_trip(RingType &ring, size_t capacity, uint32_t total) {
+    uint32_t pushed = 0, popped = 0;
+    bool in_order = true, occupancy_ok = true, full_ok = true;
+    for (size_t round = 0; popped < total; ++round) {
+        const size_t burst = 1 + round % (capacity + 3);
+        for (size_t i = 0; i < burst && pushed < total; ++i) {
+            if (try_push(ring, pushed))
+                pushed += 1;
+            else
+                full_ok = full_ok && pushed - popped == capacity;
+        }
+        occupancy_ok = occupancy_ok && ring_occupancy(ring) == pushed - popped;
+        const size_t take = 1 + round % (capacity / 2 + 1);
+        uint32_t value;
+        for (size_t i = 0; i < take && try_pop(ring, value); ++i)
+            in_order = in_order && value == popped++;
+    }
+    uint32_t value;
+    CHECK(in_order);
+    CHECK(occupancy_ok);
+    CHECK(full_ok);
+    CHECK(!try_pop(ring, value));
+}
+
+static void test_ring_wraparound() {
+    // Far more messages than the index range, so head and tail wrap many times
+    static BasicRing<uint32_t, uint8_t, 128> byte_ring;
+    ring_round_trip(byte_ring, 128, 100000);
+    static CompactRing<uint32_t, uint16_t, 16> short_ring;
+    ring_round_trip(short_ring, 16, 300000);
+    static BasicRing<uint32_t, uint16_t, 1024> padded_ring;
+    ring_round_trip(padded_ring, 1024, 300000);
+}
+
+static void test_staging() {
+    // Staged messages only become visible when published
+    static CompactRing<uint32_t, uint16_t, 8> ring;
+    size_t staged = 0;
+    for (uint32_t i = 0; i < 8; ++i)
+        CHECK(try_stage(ring, i, staged));
+    CHECK(!try_stage(ring, 8u, staged));
+    CHECK(ring_occupancy(ring) == 0);
+    publish_staged(ring, staged);
+    CHECK(staged == 0 && ring_occupancy(ring) == 8);
+}
+
+static void test_layouts() {
+    using Padded = BasicRing<uint32_t, uint16_t, 16>;
+    using Compact = CompactRing<uint32_t, uint16_t, 16>;
+    CHECK(offsetof(Padded, tail) - offsetof(Padded, head) >= 64);
+    CHECK(offsetof(Padded, buf) - offsetof(Padded, tail) >= 64);
+    CHECK(sizeof(Compact) == 2 * sizeof(uint16_t) + 16 * sizeof(uint32_t));
+}
+
+// 24 bytes, so a 4 KiB pipe fills up in the middle of a message
+struct Record {
+    uint64_t sequence;
+    uint64_t payload[2];
+};
+
+static void test_drain_to_fd() {
+    static BasicRing<Record, uint16_t, 16> ring;
+    int fds[2];
+    CHECK(pipe(fds) == 0);
+
+    // Start near the end of buf so the unread messages wrap and take both iovecs
+    Record record = {};
+    for (uint64_t i = 0; i < 11; ++i) {
+        record.sequence = i;
+        try_push(ring, record);
+        try_pop(ring, record);
+    }
+    for (uint64_t i = 0; i < 16; ++i) {
+        record = {i, {i * 3, i * 7}};
+        CHECK(try_push(ring, record));
+    }
+    CHECK(drain_to_fd(ring, fds[1], 4) == 4);
+    CHECK(drain_to_fd(ring, fds[1], 100) == 12);
+    CHECK(ring_occupancy(ring) == 0);
+    CHECK(drain_to_fd(ring, fds[1], 100) == 0);
+
+    Record out[16];
+    CHECK(read(fds[0], out, sizeof(out)) == static_cast<ssize_t>(sizeof(out)));
+    bool in_order = true;
+    for (uint64_t i = 0; i < 16; ++i)
+        in_order = in_order && out[i].sequence == i && out[i].payload[0] == i * 3 && out[i].payload[1] == i * 7;
+    CHECK(in_order);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_drain_to_fd_partial_write() {
+    static BasicRing<Record, uint16_t, 256> ring;
+    int fds[2];
+    CHECK(pipe2(fds, O_NONBLOCK) == 0);
+    CHECK(fcntl(fds[1], F_SETPIPE_SZ, 4096) == 4096);
+
+    for (uint64_t i = 0; i < 256; ++i) {
+        const Record record = {i, {i, i}};
+        CHECK(try_push(ring, record));
+    }
+
+    // The pipe takes 170 whole messages and 16 bytes of the next; the rest of it cannot be written
+    const size_t whole = 4096 / sizeof(Record);
+    errno = 0;
+    CHECK(drain_to_fd(ring, fds[1], 256) == -1);
+    CHECK(errno == EAGAIN);
+    CHECK(ring_occupancy(ring) == 256 - whole);
+
+    // Exactly the delivered messages were consumed, in order, followed by the torn one
+    uint8_t bytes[4096];
+    CHECK(read(fds[0], bytes, sizeof(bytes)) == 4096);
+    bool in_order = true;
+    for (size_t i = 0; i < whole; ++i) {
+        Record record;
+        memcpy(&record, bytes + i * sizeof(Record), sizeof(record));
+        in_order = in_order && record.sequence == i;
+    }
+    CHECK(in_order);
+    Record next;
+    CHECK(try_pop(ring, next) && next.sequence == whole);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_mailbox() {
+    static Mailbox mailbox;
+    Message command = {};
+    command.arrayOfNumbers[0] = 1.0f;
+    CHECK(send_command(mailbox, command));
+    CHECK(!send_command(mailbox, command, true));
+    uint64_t sequence = 0;
+    peek(mailbox, sequence);
+    CHECK(sequence == 1);
+
+    command.arrayOfNumbers[0] = 2.0f;
+    CHECK(send_command(mailbox, command, true));
+    CHECK(peek(mailbox, sequence).arrayOfNumbers[0] == 2.0f);
+    CHECK(sequence == 2);
+    CHECK(send_command(mailbox, command));
+    peek(mailbox, sequence);
+    CHECK(sequence == 3);
+
+    // The two slots never share a cache line
+    CHECK(offsetof(Mailbox, slots[1]) - offsetof(Mailbox, slots[0]) >= 64);
+    CHECK(offsetof(Mailbox, sequence) % 64 == 0);
+}
+
+static void test_overwrite_ring() {
+    // Twenty pushes into eight slots: the oldest twelve are lost, the rest arrive in order
+    static BasicOverwriteRing<uint32_t, 8> ring;
+    for (uint32_t i = 0; i < 20; ++i)
+        push_overwrite(ring, i);
+    uint32_t value, expected = 12;
+    bool in_order = true;
+    while (try_pop(ring, value))
+        in_order = in_order && value == expected++;
+    CHECK(in_order);
+    CHECK(expected == 20);
+    CHECK(ring.lost == 12);
+}
+
+int main() {
+    test_ring_wraparound();
+    test_staging();
+    test_layouts();
+    test_drain_to_fd();
+    test_drain_to_fd_partial_write();
+    test_mailbox();
+    test_overwrite_ring();
+    return check_report();
+}
@@ -0,0 +1,112 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "check.h"
+#include "recording_reader.h"
+#include "segmented_recorder.h"
+
+/*
+ * Tests for size-based rotation and retention of the segmented recorder.
+ */
+
+// Every unlink() in this process goes through here, so the test can see which thread deleted segments
+static std::thread::id appending_thread;
+static std::atomic<bool> appending{false};
+static std::atomic<size_t> unlinks_while_appending{0};
+static std::atomic<size_t> unlinks_on_append_path{0};
+
+extern "C" int unlink(const char *path) {
+    if (appending.load(std::memory_order_acquire)) {
+        unlinks_while_appending.fetch_add(1, std::memory_order_relaxed);
+        if (std::this_thread::get_id() == appending_thread)
+            unlinks_on_append_path.fetch_add(1, std::memory_order_relaxed);
+    }
+    return static_cast<int>(syscall(SYS_unlinkat, AT_FDCWD, path, 0));
+}
+
+static Sample<Message> make_sample(uint64_t i) {
+    Sample<Message> sample{};
+    sample.cycle = i;
+    sample.time_ns = static_cast<int64_t>(i) * 1000;
+    for (size_t a = 0; a < Message::axes; ++a)
+        sample.msg.arrayOfNumbers[a] = static_cast<float>(i) + static_cast<float>(a);
+    return sample;
+}
+
+static std::vector<std::string> list_segments(const std::string &dir) {
+    std::vector<std::string> names;
+    DIR *d = opendir(dir.c_str());
+    for (dirent *entry = d != nullptr ? readdir(d) : nullptr; entry != nullptr; entry = readdir(d)) {
+        const std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".rec") == 0)
+            names.push_back(name);
+    }
+    if (d != nullptr)
+        closedir(d);
+    return names;
+}
+
+static void test_rotation_and_retention(const std::string &dir) {
+    SegmentedRecorder recorder;
+    recorder.base = dir + "/seg";
+    recorder.segment_bytes = 64 * 1024;
+    recorder.keep_segments = 3;
+    recorder.axes = Message::axes;
+    recorder.value_type = VALUE_F32;
+    recorder.chunk_records = 64;
+    CHECK(segmented_open(recorder));
+
+    appending_thread = std::this_thread::get_id();
+    appending.store(true, std::memory_order_release);
+    const uint64_t total = 20000;
+    bool appended = true;
+    for (uint64_t i = 0; i < total; ++i)
+        appended = appended && segmented_append_sample(recorder, make_sample(i));
+    const uint64_t last_sequence = recorder.sequence;
+    CHECK(segmented_close(recorder));
+    appending.store(false, std::memory_order_release);
+    CHECK(appended);
+
+    // 64 KiB holds about 20 chunks of 64 records, so this rotated many times
+    CHECK(last_sequence >= 10);
+    CHECK(unlinks_while_appending.load() >= 2 * (last_sequence + 1 - recorder.keep_segments));
+    CHECK(unlinks_on_append_path.load() == 0);
+
+    // Only the newest segments are left, and they hold the last records without gaps
+    std::vector<std::string> left = list_segments(dir);
+    CHECK(left.size() == recorder.keep_segments);
+    uint64_t next_cycle = 0;
+    bool contiguous = true;
+    for (uint64_t s = last_sequence + 1 - recorder.keep_segments; s <= last_sequence; ++s) {
+        RecordingReader reader;
+        CHECK(reader_open(reader, segment_path(recorder, s).c_str()));
+        CHECK(reader.file_size <= recorder.segment_bytes);
+        for (size_t c = 0; c < reader.index.size(); ++c) {
+            ChunkView view;
+            CHECK(reader_map_chunk(reader, c, view));
+            for (size_t r = 0; r < view.count; ++r) {
+                const uint64_t cycle = chunk_record_prefix(view, r).cycle;
+                contiguous = contiguous && (next_cycle == 0 || cycle == next_cycle);
+                next_cycle = cycle + 1;
+            }
+            reader_unmap_chunk(view);
+        }
+        reader_close(reader);
+    }
+    CHECK(contiguous);
+    CHECK(next_cycle == total);
+}
+
+int main() {
+    const std::string dir = check_temp_dir();
+    test_rotation_and_retention(dir);
+    check_remove_dir(dir);
+    return check_report();
+}
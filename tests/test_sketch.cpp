@@ -0,0 +1,109 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "check.h"
+#include "quantile_sketch.h"
+
+/*
+ * Tests for the quantile sketches: relative error bound, merging, batches and rolling windows.
+ */
+
+static void test_error_bound() {
+    const double accuracy = 0.01;
+    std::mt19937 rng(1);
+    std::lognormal_distribution<double> lognormal(0.0, 2.0);
+    std::normal_distribution<double> normal(-5.0, 3.0);
+    std::vector<double> values(100000);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = i % 2 ? lognormal(rng) : normal(rng);
+
+    static QuantileSketch<> whole, first, second;
+    sketch_init(whole, accuracy);
+    sketch_init(first, accuracy);
+    sketch_init(second, accuracy);
+    for (size_t i = 0; i < values.size(); ++i) {
+        sketch_add(whole, values[i]);
+        sketch_add(i < values.size() / 2 ? first : second, values[i]);
+    }
+    sketch_add(whole, NAN);
+    CHECK(whole.count == values.size());
+    CHECK(sketch_merge(first, second));
+
+    // Every quantile of the whole and of the merged halves is within 1% of the exact one
+    std::sort(values.begin(), values.end());
+    bool whole_ok = true, merged_ok = true;
+    for (double q : {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999, 1.0}) {
+        const double exact = values[static_cast<size_t>(q * static_cast<double>(values.size() - 1))];
+        const double bound = accuracy * fabs(exact) + 1e-12;
+        whole_ok = whole_ok && fabs(sketch_quantile(whole, q) - exact) <= bound;
+        merged_ok = merged_ok && fabs(sketch_quantile(first, q) - exact) <= bound;
+    }
+    CHECK(whole_ok);
+    CHECK(merged_ok);
+
+    static QuantileSketch<> empty, coarse;
+    sketch_init(empty, accuracy);
+    sketch_init(coarse, 0.05);
+    CHECK(isnan(sketch_quantile(empty, 0.5)));
+    CHECK(!sketch_merge(coarse, whole));
+}
+
+static void test_batch_matches_single() {
+    // The vectorized batch path puts every value into the same bucket as sketch_add
+    std::mt19937 rng(2);
+    std::lognormal_distribution<float> lognormal(0.0f, 3.0f);
+    std::vector<float> values(5000);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = i % 3 == 0 ? -lognormal(rng) : i % 97 == 0 ? 0.0f : lognormal(rng);
+    values[10] = INFINITY;
+
+    static QuantileSketch<> single, batch;
+    sketch_init(single, 0.01);
+    sketch_init(batch, 0.01);
+    for (float value : values)
+        sketch_add(single, value);
+    sketch_add_batch(batch, values.data(), values.size());
+    CHECK(single.count == batch.count && single.count == values.size() - 1);
+    bool same = true;
+    for (double q = 0.0; q <= 1.0; q += 0.01)
+        same = same && sketch_quantile(single, q) == sketch_quantile(batch, q);
+    CHECK(same);
+}
+
+static void test_rolling_window() {
+    // Four slots of one second each: old values fall out as time moves on
+    static RollingSketches<Message::axes, 4> rolling;
+    rolling_init(rolling, 0.01, 1000000000);
+    std::vector<Sample<Message>> samples(100);
+    for (int64_t second = 0; second < 10; ++second) {
+        for (size_t i = 0; i < samples.size(); ++i) {
+            samples[i] = Sample<Message>{};
+            samples[i].time_ns = second * 1000000000 + static_cast<int64_t>(i) * 10000000;
+            samples[i].msg.arrayOfNumbers[0] = static_cast<float>(second * 100 + 1);
+        }
+        rolling_add_samples(rolling, samples.data(), samples.size());
+    }
+
+    static FieldSketches<Message::axes> merged;
+    rolling_merged(rolling, merged);
+    CHECK(merged.field[0].count == 400);
+    CHECK(fabs(sketch_quantile(merged.field[0], 0.0) - 601.0) <= 6.01);
+    CHECK(fabs(sketch_quantile(merged.field[0], 1.0) - 901.0) <= 9.01);
+
+    // A late sample that is older than the window is dropped
+    samples[0].time_ns = 0;
+    rolling_add_samples(rolling, samples.data(), 1);
+    rolling_merged(rolling, merged);
+    CHECK(merged.field[0].count == 400);
+}
+
+int main() {
+    test_error_bound();
+    test_batch_matches_single();
+    test_rolling_window();
+    return check_report();
+}
@@ -0,0 +1,102 @@
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+#include "check.h"
+#include "spectrum.h"
+
+/*
+ * Tests for the real FFT and the streaming spectral analyzer.
+ */
+
+using Analyzer = SpectrumAnalyzer<Message::axes, 64, 32>;
+
+static void test_fft_against_dft() {
+    constexpr size_t N = 64;
+    static FftPlan<N> plan;
+    fft_plan_init(plan);
+    float input[N], power[N / 2 + 1];
+    for (size_t n = 0; n < N; ++n)
+        input[n] = sinf(0.7f * n) + 0.3f * cosf(2.1f * n) + 0.1f * n;
+    fft_real_power(plan, input, power);
+
+    const double pi = 3.14159265358979323846;
+    double worst = 0.0;
+    for (size_t k = 0; k <= N / 2; ++k) {
+        std::complex<double> sum = 0.0;
+        for (size_t n = 0; n < N; ++n)
+            sum += static_cast<double>(input[n]) * plan.window[n] * std::polar(1.0, -2.0 * pi * k * n / N);
+        worst = std::max(worst, fabs(std::norm(sum) - power[k]) / (1.0 + std::norm(sum)));
+    }
+    CHECK(worst < 1e-4);
+}
+
+/**
+ * @brief `count` samples of a sine with period 8 samples, 4 per cycle, continuing from `first`
+ */
+static std::vector<Sample<Message>> sine(uint64_t first, size_t count, uint32_t decimation = 1) {
+    std::vector<Sample<Message>> samples(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t n = first + i;
+        samples[i].cycle = 1 + n / 4 * decimation;
+        samples[i].subsample = static_cast<uint32_t>(n % 4);
+        samples[i].decimation = decimation;
+        samples[i].msg.arrayOfNumbers[0] = sinf(2.0f * 3.14159265f * static_cast<float>(n) / 8.0f);
+    }
+    return samples;
+}
+
+static void test_peak_over_subsamples() {
+    // Sub-samples of consecutive cycles form one stream; the sine shows up in bin 64 / 8
+    static Analyzer analyzer;
+    spectrum_init(analyzer, 1.0f, 4);
+    const std::vector<Sample<Message>> samples = sine(0, 256);
+    CHECK(spectrum_add_samples(analyzer, samples.data(), 100) == 2);
+    CHECK(spectrum_add_samples(analyzer, samples.data() + 100, 156) == 5);
+    CHECK(analyzer.resets == 0);
+    CHECK(spectrum_peak(analyzer, 0) == 8);
+    CHECK(spectrum_bin_hz(analyzer, 8, 200.0) == 25.0);
+}
+
+static void test_restart_on_gap_and_rate_change() {
+    static Analyzer analyzer;
+    spectrum_init(analyzer, 1.0f, 4);
+    std::vector<Sample<Message>> samples = sine(0, 96);
+    CHECK(spectrum_add_samples(analyzer, samples.data(), samples.size()) == 2);
+
+    // A missing sub-sample restarts the history: no frame until N new samples arrived
+    samples = sine(97, 63);
+    CHECK(spectrum_add_samples(analyzer, samples.data(), samples.size()) == 0);
+    CHECK(analyzer.resets == 1 && analyzer.written == 63);
+    samples = sine(160, 1);
+    CHECK(spectrum_add_samples(analyzer, samples.data(), 1) == 1);
+    CHECK(analyzer.frames == 3);
+
+    // So does a skipped cycle, here the one after the cycle of sample 160
+    samples = sine(161, 3);
+    spectrum_add_samples(analyzer, samples.data(), samples.size());
+    CHECK(analyzer.resets == 1);
+    samples = sine(168, 1);
+    spectrum_add_samples(analyzer, samples.data(), 1);
+    CHECK(analyzer.resets == 2 && analyzer.written == 1 && analyzer.frames == 3);
+
+    // A new decimation changes the sample rate, so the averaged spectrum is dropped as well
+    samples = sine(1000, 64, 2);
+    CHECK(spectrum_add_samples(analyzer, samples.data(), samples.size()) == 1);
+    CHECK(analyzer.resets == 3 && analyzer.frames == 1 && analyzer.decimation == 2);
+
+    // Cycles that are `decimation` apart are consecutive at that rate
+    samples = sine(1064, 32, 2);
+    CHECK(spectrum_add_samples(analyzer, samples.data(), samples.size()) == 1);
+    CHECK(analyzer.resets == 3 && analyzer.frames == 2);
+}
+
+int main() {
+    test_fft_against_dft();
+    test_peak_over_subsamples();
+    test_restart_on_gap_and_rate_change();
+    return check_report();
+}
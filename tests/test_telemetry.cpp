@@ -0,0 +1,114 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "check.h"
+#include "rt_logic.h"
+#include "telemetry.h"
+
+/*
+ * Tests for the RT -> Observer telemetry channel and its RT-side policies.
+ */
+
+static void test_rate_governor() {
+    RateGovernor governor;
+    CHECK(!rate_governor_init(governor, 10, 10, 4, 8));
+    CHECK(!rate_governor_init(governor, 10, 2, 4, 0));
+    CHECK(rate_governor_init(governor, 10, 2, 4, 6));
+
+    // Sustained pressure doubles the divider up to the (non power of two) maximum
+    uint32_t largest = 0;
+    for (uint64_t cycle = 0; cycle < 1000; ++cycle) {
+        rate_should_send(governor, 10, cycle);
+        largest = std::max(largest, governor.decimation);
+    }
+    CHECK(largest == 6);
+    CHECK(governor.decimation == 6);
+
+    // Only cycles on the current stride are sent
+    size_t sent = 0;
+    for (uint64_t cycle = 1000; cycle < 1060; ++cycle)
+        sent += rate_should_send(governor, 5, cycle);
+    CHECK(sent == 10);
+
+    // Calm sends bring it back to full rate
+    for (uint64_t cycle = 2000; cycle < 3000; ++cycle)
+        rate_should_send(governor, 0, cycle);
+    CHECK(governor.decimation == 1);
+}
+
+static void test_staged_batches() {
+    // The request's case: 20 sub-samples per 2 ms cycle fit several times over
+    static TelemetryChannel<Message> channel;
+    static_assert(TelemetryChannel<Message>::bulk_capacity >= 4 * 20, "default bulk lane too small");
+
+    auto drain = [](auto &rx, uint32_t *subsamples) {
+        size_t n = 0;
+        telemetry_drain(rx, [](const TelemetryEvent &) {},
+                        [&](const Sample<Message> &sample) { subsamples[n++] = sample.subsample; });
+        return n;
+    };
+    uint32_t subsamples[128];
+    for (uint64_t cycle = 1; cycle <= 3; ++cycle) {
+        size_t staged = 0;
+        for (uint32_t k = 0; k < 20; ++k) {
+            Sample<Message> sample{};
+            sample.cycle = cycle;
+            sample.subsample = k;
+            CHECK(telemetry_stage_sample(channel, sample, staged));
+        }
+        // Nothing of this cycle is visible until it is published
+        CHECK(staged == 20);
+        CHECK(ring_occupancy(channel.bulk) == 20 * (cycle - 1));
+        telemetry_publish_samples(channel, staged);
+        CHECK(staged == 0);
+        CHECK(ring_occupancy(channel.bulk) == 20 * cycle);
+    }
+    CHECK(drain(channel, subsamples) == 60);
+    bool in_order = true;
+    for (size_t i = 0; i < 60; ++i)
+        in_order = in_order && subsamples[i] == i % 20;
+    CHECK(in_order);
+
+    // A batch larger than the lane is cut short and the rest counted as dropped
+    static TelemetryChannel<Message, BulkPolicy::DropNewest, 8> small;
+    size_t staged = 0;
+    for (uint32_t k = 0; k < 12; ++k) {
+        Sample<Message> sample{};
+        sample.subsample = k;
+        telemetry_stage_sample(small, sample, staged);
+    }
+    telemetry_publish_samples(small, staged);
+    CHECK(small.samples_dropped == 4);
+    CHECK(drain(small, subsamples) == 8);
+}
+
+static void test_rt_step_publishes_whole_cycles() {
+    static Telemetry tx;
+    RtState state;
+    Message command = {};
+    command.keepRunning = true;
+    command.arrayOfNumbers[0] = 100.0f;
+    CHECK(rt_step(state, command, 1000, tx));
+    CHECK(rt_step(state, command, 1000 + RT_PERIOD_NS, tx));
+
+    std::vector<Sample<Message>> samples;
+    telemetry_drain(tx, [](const TelemetryEvent &) {}, [&](const Sample<Message> &s) { samples.push_back(s); });
+    CHECK(samples.size() == 2 * RT_SUBSAMPLES);
+    bool stamped = true;
+    for (size_t i = 0; i < samples.size(); ++i) {
+        const uint64_t cycle = 1 + i / RT_SUBSAMPLES;
+        const uint32_t k = static_cast<uint32_t>(i % RT_SUBSAMPLES);
+        stamped = stamped && samples[i].cycle == cycle && samples[i].subsample == k
+               && samples[i].time_ns == 1000 + static_cast<int64_t>(cycle - 1) * RT_PERIOD_NS + k * RT_SUBSAMPLE_NS;
+    }
+    CHECK(stamped);
+}
+
+int main() {
+    test_rate_governor();
+    test_staged_batches();
+    test_rt_step_publishes_whole_cycles();
+    return check_report();
+}
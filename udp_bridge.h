@@ -0,0 +1,274 @@
+#pragma once
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "spsc.h"
+#include "telemetry.h"
+
+/*
+ * Telemetry bridge wire format
+ *
+ * Every UDP datagram is a BridgeHeader followed by `count` raw samples. The
+ * sequence number is that of the first sample; samples are numbered
+ * consecutively from 0, so the receiver can tell exactly how many samples a
+ * lost datagram carried. Both ends must run the same build (same Sample
+ * layout); `sample_size` guards against mismatches. Datagrams stay below the
+ * Ethernet MTU so they are never fragmented off loopback either.
+ */
+
+constexpr uint32_t BRIDGE_MAGIC = 0x42555053; // "SPUB"
+constexpr uint16_t BRIDGE_VERSION = 1;
+constexpr size_t BRIDGE_MAX_DATAGRAM = 1472; // 1500 MTU - IPv4 - UDP headers
+constexpr size_t BRIDGE_BATCH = 32;          // datagrams per sendmmsg/recvmmsg
+
+struct BridgeHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+    uint32_t sample_size;
+    uint32_t reserved;
+    uint64_t sequence;
+    int64_t send_time_ns;
+};
+
+static_assert(sizeof(BridgeHeader) == 32, "BridgeHeader layout changed.");
+
+// Observer -> bridge channel, placed in shared memory by spsc_app --export
+using ExportRing = BasicRing<Sample<Message>, uint32_t, 1024>;
+
+/**
+ * @brief Sending end of the bridge: drains a ring into batched datagrams.
+ */
+template <typename Msg>
+struct BridgeSender {
+    static constexpr size_t per_datagram = (BRIDGE_MAX_DATAGRAM - sizeof(BridgeHeader)) / sizeof(Sample<Msg>);
+    static_assert(per_datagram > 0, "Samples are too large for one datagram.");
+
+    int fd = -1;
+    uint64_t sequence = 0;
+    uint64_t datagrams_sent = 0;
+    uint64_t send_errors = 0;
+
+    uint8_t buffers[BRIDGE_BATCH][sizeof(BridgeHeader) + per_datagram * sizeof(Sample<Msg>)];
+    struct iovec iov[BRIDGE_BATCH];
+    struct mmsghdr msgs[BRIDGE_BATCH];
+};
+
+/**
+ * @brief Receiving end of the bridge: feeds datagrams into a local ring.
+ *
+ * `lost` counts samples that never arrived (from sequence gaps), `stale`
+ * datagrams that arrived out of order or twice and were discarded, and
+ * `overflows` samples that did not fit into the local ring. Counting starts
+ * at the first datagram accepted, so a receiver that joins a running sender
+ * does not book everything sent before it as lost.
+ */
+template <typename Msg>
+struct BridgeReceiver {
+    int fd = -1;
+    bool synced = false; // `expected` has been taken from the first accepted datagram
+    uint64_t expected = 0;
+    uint64_t received = 0;
+    uint64_t lost = 0;
+    uint64_t stale = 0;
+    uint64_t overflows = 0;
+    int64_t last_send_time_ns = 0;
+
+    uint8_t buffers[BRIDGE_BATCH][BRIDGE_MAX_DATAGRAM];
+    struct iovec iov[BRIDGE_BATCH];
+    struct mmsghdr msgs[BRIDGE_BATCH];
+};
+
+/**
+ * @brief Opens a UDP socket connected to `host:port`
+ * @param sender The sender to set up
+ * @param host IPv4 address, e.g. "127.0.0.1"
+ * @param port UDP port
+ * @return true if the socket is ready
+ */
+template <typename Msg>
+bool bridge_sender_open(BridgeSender<Msg> &sender, const char *host, uint16_t port) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        return false;
+
+    sender.fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sender.fd < 0)
+        return false;
+    if (connect(sender.fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(sender.fd);
+        sender.fd = -1;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Pops what the ring holds (up to one batch) and sends it with a single sendmmsg
+ *
+ * Datagrams are filled completely when enough samples are waiting, but a
+ * partial one is sent rather than waiting for more, so a quiet stream adds no
+ * batching delay.
+ *
+ * @param sender The sender to use
+ * @param ring The ring to drain
+ * @return Number of samples sent, or -1 if sendmmsg failed
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+ssize_t bridge_send(BridgeSender<Msg> &sender, BasicRing<Sample<Msg>, Index, Capacity, IndexAlign> &ring) {
+    constexpr size_t per = BridgeSender<Msg>::per_datagram;
+    size_t datagrams = 0;
+    size_t samples = 0;
+    const int64_t now = realtime_now_ns();
+
+    while (datagrams < BRIDGE_BATCH) {
+        uint8_t *buffer = sender.buffers[datagrams];
+        Sample<Msg> *payload = reinterpret_cast<Sample<Msg> *>(buffer + sizeof(BridgeHeader));
+        size_t count = 0;
+        while (count < per && try_pop(ring, payload[count]))
+            ++count;
+        if (count == 0)
+            break;
+
+        BridgeHeader header = {BRIDGE_MAGIC, BRIDGE_VERSION, static_cast<uint16_t>(count),
+                               static_cast<uint32_t>(sizeof(Sample<Msg>)), 0, sender.sequence, now};
+        memcpy(buffer, &header, sizeof(header));
+        sender.sequence += count;
+        samples += count;
+
+        sender.iov[datagrams] = {buffer, sizeof(BridgeHeader) + count * sizeof(Sample<Msg>)};
+        sender.msgs[datagrams] = {};
+        sender.msgs[datagrams].msg_hdr.msg_iov = &sender.iov[datagrams];
+        sender.msgs[datagrams].msg_hdr.msg_iovlen = 1;
+        ++datagrams;
+        if (count < per)
+            break;
+    }
+
+    // sendmmsg may stop early; resend the rest so sequence numbers stay contiguous
+    size_t sent = 0;
+    while (sent < datagrams) {
+        int n = sendmmsg(sender.fd, sender.msgs + sent, static_cast<unsigned>(datagrams - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            sender.send_errors += 1;
+            return -1;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    sender.datagrams_sent += datagrams;
+    return static_cast<ssize_t>(samples);
+}
+
+/**
+ * @brief Binds a UDP socket on `host:port` for the receiver
+ * @param receiver The receiver to set up
+ * @param host IPv4 address to bind, e.g. "127.0.0.1"
+ * @param port UDP port
+ * @param timeout_ms How long bridge_receive() waits for the first datagram
+ * @return true if the socket is ready
+ */
+template <typename Msg>
+bool bridge_receiver_open(BridgeReceiver<Msg> &receiver, const char *host, uint16_t port, int timeout_ms = 100) {
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        return false;
+
+    receiver.fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (receiver.fd < 0)
+        return false;
+
+    int rcvbuf = 4 << 20;
+    setsockopt(receiver.fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    setsockopt(receiver.fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (bind(receiver.fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0) {
+        close(receiver.fd);
+        receiver.fd = -1;
+        return false;
+    }
+
+    for (size_t i = 0; i < BRIDGE_BATCH; ++i) {
+        receiver.iov[i] = {receiver.buffers[i], BRIDGE_MAX_DATAGRAM};
+        receiver.msgs[i] = {};
+        receiver.msgs[i].msg_hdr.msg_iov = &receiver.iov[i];
+        receiver.msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Receives up to one batch of datagrams and pushes their samples into a local ring
+ *
+ * Waits up to the receive timeout for the first datagram, then takes whatever
+ * else is already queued with the same recvmmsg call. Samples that arrived
+ * and samples that did not fit into the ring are counted in `received` and
+ * `overflows`, so a full ring is not mistaken for a quiet socket.
+ *
+ * @param receiver The receiver to use
+ * @param ring The local ring to feed
+ * @return Number of datagrams received, including discarded ones; 0 on timeout, or -1 on a socket error
+ */
+template <typename Msg, typename Index, size_t Capacity, size_t IndexAlign>
+ssize_t bridge_receive(BridgeReceiver<Msg> &receiver, BasicRing<Sample<Msg>, Index, Capacity, IndexAlign> &ring) {
+    int n = recvmmsg(receiver.fd, receiver.msgs, BRIDGE_BATCH, MSG_WAITFORONE, nullptr);
+    if (n < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+
+    for (int i = 0; i < n; ++i) {
+        const size_t len = receiver.msgs[i].msg_len;
+        const uint8_t *buffer = receiver.buffers[i];
+        BridgeHeader header;
+        if (len < sizeof(header))
+            continue;
+        memcpy(&header, buffer, sizeof(header));
+        if (header.magic != BRIDGE_MAGIC || header.version != BRIDGE_VERSION
+            || header.sample_size != sizeof(Sample<Msg>)
+            || len < sizeof(header) + header.count * sizeof(Sample<Msg>))
+            continue;
+
+        if (!receiver.synced) {
+            receiver.expected = header.sequence;
+            receiver.synced = true;
+        }
+        if (header.sequence < receiver.expected) {
+            receiver.stale += 1;
+            continue;
+        }
+        receiver.lost += header.sequence - receiver.expected;
+        receiver.expected = header.sequence + header.count;
+        receiver.received += header.count;
+        receiver.last_send_time_ns = header.send_time_ns;
+
+        for (size_t s = 0; s < header.count; ++s) {
+            Sample<Msg> sample;
+            memcpy(&sample, buffer + sizeof(header) + s * sizeof(Sample<Msg>), sizeof(sample));
+            if (!try_push(ring, sample))
+                receiver.overflows += 1;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Closes a bridge socket
+ */
+template <typename End>
+void bridge_close(End &end) {
+    if (end.fd >= 0)
+        close(end.fd);
+    end.fd = -1;
+}